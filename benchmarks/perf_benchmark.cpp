@@ -2,25 +2,27 @@
 #include <matching_engine.h>
 #include <chrono>
 #include <random>
+#include <vector>
 
 static void BM_ProcessNewOrder(benchmark::State& state) {
         MatchingEngine engine;
-        OrderBook& book = engine.get_or_create_order_book("AAPL");
+        SymbolId aapl = engine.symbols().intern("AAPL");
+        OrderBook& book = engine.get_or_create_order_book(aapl);
         Order sell_order{
                 .id = 1,
-                .symbol = "AAPL",
+                .symbol = aapl,
                 .side = OrderSide::SELL,
                 .type = OrderType::LIMIT,
-                .price = 150.0,
+                .price = 150,
                 .quantity = 10,
                 .timestamp = 0
         };
         Order buy_order{
                 .id = 2,
-                .symbol = "AAPL",
+                .symbol = aapl,
                 .side = OrderSide::BUY,
                 .type = OrderType::LIMIT,
-                .price = 150.0,
+                .price = 150,
                 .quantity = 10,
                 .timestamp = 0
         };
@@ -33,5 +35,132 @@ static void BM_ProcessNewOrder(benchmark::State& state) {
         state.SetItemsProcessed(state.iterations() * 2); // Each iteration processes 2 orders
 }
 BENCHMARK(BM_ProcessNewOrder)->Unit(benchmark::kNanosecond);
+
+// Same flow through the sink entry point, which hands fills over without building a vector
+static void BM_ProcessNewOrderSink(benchmark::State& state) {
+        MatchingEngine engine;
+        SymbolId aapl = engine.symbols().intern("AAPL");
+        engine.get_or_create_order_book(aapl);
+        Order sell_order{
+                .id = 1,
+                .symbol = aapl,
+                .side = OrderSide::SELL,
+                .type = OrderType::LIMIT,
+                .price = 150,
+                .quantity = 10,
+                .timestamp = 0
+        };
+        Order buy_order = sell_order;
+        buy_order.id = 2;
+        buy_order.side = OrderSide::BUY;
+
+        Quantity filled = 0;
+        auto on_trade = [&filled](const Trade& trade) { filled += trade.quantity; };
+        for (auto _ : state) {
+                engine.process_new_order(sell_order, on_trade);
+                engine.process_new_order(buy_order, on_trade);
+        }
+        benchmark::DoNotOptimize(filled);
+        state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_ProcessNewOrderSink)->Unit(benchmark::kNanosecond);
+
+// Orders spread round-robin over eight symbols: a block of resting sells per symbol,
+// then a block of buys that takes them all out, cycling over a few price levels
+static std::vector<Order> makeCrossingBatch(MatchingEngine& engine, size_t batch_size) {
+        std::vector<SymbolId> symbols;
+        for (const char* name : {"AAPL", "MSFT", "GOOG", "AMZN", "NVDA", "META", "TSLA", "NFLX"}) {
+                symbols.push_back(engine.symbols().intern(name));
+        }
+        std::vector<Order> batch;
+        for (size_t i = 0; i < batch_size; ++i) {
+                batch.push_back(Order{
+                        .id = i + 1,
+                        .symbol = symbols[i % symbols.size()],
+                        .side = (i / symbols.size()) % 2 == 0 ? OrderSide::SELL : OrderSide::BUY,
+                        .type = OrderType::LIMIT,
+                        .price = static_cast<Price>(150 + (i / (2 * symbols.size())) % 8),
+                        .quantity = 10,
+                        .timestamp = 0
+                });
+        }
+        return batch;
+}
+
+// Replay-style flow: a batch of crossing orders over several symbols in one call
+static void BM_ProcessOrdersBatch(benchmark::State& state) {
+        MatchingEngine engine;
+        const size_t batch_size = static_cast<size_t>(state.range(0));
+        std::vector<Order> batch = makeCrossingBatch(engine, batch_size);
+
+        Quantity filled = 0;
+        auto on_trade = [&filled](const Trade& trade) { filled += trade.quantity; };
+        for (auto _ : state) {
+                engine.process_orders(batch, on_trade);
+        }
+        benchmark::DoNotOptimize(filled);
+        state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_ProcessOrdersBatch)->Arg(64)->Arg(1024)->Unit(benchmark::kNanosecond);
+
+// The same batch one order at a time, for comparison with BM_ProcessOrdersBatch
+static void BM_ProcessOrdersSequential(benchmark::State& state) {
+        MatchingEngine engine;
+        const size_t batch_size = static_cast<size_t>(state.range(0));
+        std::vector<Order> batch = makeCrossingBatch(engine, batch_size);
+
+        Quantity filled = 0;
+        auto on_trade = [&filled](const Trade& trade) { filled += trade.quantity; };
+        for (auto _ : state) {
+                for (const Order& order : batch) {
+                        engine.process_new_order(order, on_trade);
+                }
+        }
+        benchmark::DoNotOptimize(filled);
+        state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_ProcessOrdersSequential)->Arg(64)->Arg(1024)->Unit(benchmark::kNanosecond);
+// An opening: orders arrive for one symbol with buys and sells overlapping by ten
+// ticks. range(1) = 0 matches them continuously as they arrive; 1 collects them in an
+// auction and uncrosses once. Clearing the book between iterations is not timed.
+static void BM_OpeningCross(benchmark::State& state) {
+        MatchingEngine engine;
+        const size_t order_count = static_cast<size_t>(state.range(0));
+        const bool auction = state.range(1) != 0;
+        SymbolId symbol = engine.symbols().intern("AAPL");
+        std::vector<Order> orders;
+        for (size_t i = 0; i < order_count; ++i) {
+                const bool buy = i % 2 == 0;
+                orders.push_back(Order{
+                        .id = i + 1,
+                        .symbol = symbol,
+                        .side = buy ? OrderSide::BUY : OrderSide::SELL,
+                        .type = OrderType::LIMIT,
+                        .price = static_cast<Price>((buy ? 100 : 90) + (i * 7) % 20),
+                        .quantity = 10 + i % 5,
+                        .timestamp = 0
+                });
+        }
+
+        Quantity filled = 0;
+        auto on_trade = [&filled](const Trade& trade) { filled += trade.quantity; };
+        for (auto _ : state) {
+                if (auction) {
+                        engine.begin_auction(symbol);
+                }
+                for (const Order& order : orders) {
+                        engine.process_new_order(order, on_trade);
+                }
+                if (auction) {
+                        engine.uncross(symbol, on_trade);
+                }
+                state.PauseTiming();
+                engine.cancel_all(symbol);
+                state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(filled);
+        state.SetItemsProcessed(state.iterations() * order_count);
+}
+BENCHMARK(BM_OpeningCross)->Args({1024, 0})->Args({1024, 1})->Unit(benchmark::kMicrosecond);
 BENCHMARK_MAIN();
     
\ No newline at end of file
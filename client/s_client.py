@@ -9,6 +9,7 @@ HOST = 'localhost'
 PORT = 8080
 USER = "Trader1"
 PASS = "password"
+USER_ID = 1 # Owner id sent with orders and cancels
 
 # --- COLORS ---
 class Colors:
@@ -36,6 +37,7 @@ class TradingShell:
         self.base_prompt = f"{Colors.BOLD}Command (O/M/S/X/C): {Colors.ENDC}"
         self.current_prompt = self.base_prompt 
         self.lock = threading.Lock() 
+        self.books = {} # symbol -> {'seq', 'bids', 'asks', 'loading'}, mirrored from 'U' updates
 
     # --- UI HELPERS ---
     def clean_print(self, text, color=Colors.ENDC):
@@ -132,7 +134,7 @@ class TradingShell:
             self.clean_print(f"[TICKER] {sym} {qty} @ ${px:.2f}", Colors.CYAN)
 
         elif mtype == 'E': # Execution
-            cid, eid, sym, side, px, qty, filled, stat = struct.unpack('<QQ10sBdQQB', data)
+            cid, uid, eid, sym, side, px, qty, filled, stat = struct.unpack('<QQQ10sBdQQB', data)
             sym = sym.decode().strip('\x00')
             side_str = "BUY" if side == 0 else "SELL"
             status_map = {0:"New", 1:"Partial", 2:"FILLED", 3:"Cancelled"}
@@ -161,6 +163,39 @@ class TradingShell:
             
             self.clean_print("\n".join(lines))
 
+        elif mtype == 'U': # L2 update: level deltas, or a snapshot split by flags
+            sym_raw, seq, flags, n_levels = struct.unpack('<10sQBB', data[:20])
+            sym = sym_raw.decode().strip('\x00')
+            book = self.books.setdefault(sym, {'seq': None, 'bids': {}, 'asks': {}, 'loading': False})
+            if flags & 1: # Snapshot begins: start over
+                book.update(bids={}, asks={}, loading=True)
+            elif not book['loading']:
+                if book['seq'] is None: return # Waiting for a snapshot
+                if seq != book['seq'] + 1:
+                    # Missed updates: subscribing again asks for a fresh snapshot
+                    self.clean_print(f"[System] Gap in {sym} book ({book['seq']} -> {seq}), resyncing", Colors.WARNING)
+                    book['seq'] = None
+                    self.send_packet('Q', struct.pack('<10sB', sym_raw, 1))
+                    return
+            book['seq'] = seq
+
+            offset = 20
+            for i in range(n_levels):
+                p, q, side, action = struct.unpack('<dQBB', data[offset:offset+18])
+                levels = book['bids'] if side == 0 else book['asks']
+                if action == 2: levels.pop(p, None)
+                else: levels[p] = q
+                offset += 18
+            if flags & 2: book['loading'] = False
+            if book['loading']: return
+
+            lines = [f"\n--- BOOK: {sym} (seq {seq}) ---"]
+            for p in sorted(book['bids'], reverse=True)[:5]:
+                lines.append(f"{Colors.GREEN}BID: {book['bids'][p]} @ {p:.2f}{Colors.ENDC}")
+            for p in sorted(book['asks'])[:5]:
+                lines.append(f"{Colors.FAIL}ASK: {book['asks'][p]} @ {p:.2f}{Colors.ENDC}")
+            self.clean_print("\n".join(lines))
+
     # --- MAIN LOOP ---
     def run(self):
         if not self.connect(): return
@@ -187,7 +222,7 @@ class TradingShell:
                         px = float(self.smart_input(f"{Colors.HEADER}  Price: {Colors.ENDC}"))
                         qty = int(self.smart_input(f"{Colors.HEADER}  Qty: {Colors.ENDC}"))
                         
-                        payload = struct.pack('<Q10sBBdQ', self._get_seq(), sym.encode().ljust(10), side, type_, px, qty)
+                        payload = struct.pack('<QQ10sBBdQ', self._get_seq(), USER_ID, sym.encode().ljust(10), side, type_, px, qty)
                         self.send_packet('N', payload)
                         self.clean_print("Order Sent.", Colors.GREEN)
                     except ValueError:
@@ -207,7 +242,7 @@ class TradingShell:
                     oid = int(self.smart_input("Order ID to Cancel: "))
                     sym = self.smart_input("Symbol to Cancel: ")
                     side = 0 if self.smart_input("Side (B/S): ").upper() == 'B' else 1
-                    payload = struct.pack('<Q10sB', oid, sym.encode().ljust(10), side)
+                    payload = struct.pack('<QQ10sB', oid, USER_ID, sym.encode().ljust(10), side)
                     self.send_packet('C', payload)
                     self.clean_print(f"Cancel Sent for Order ID {oid} on Symbol {sym}", Colors.WARNING)
 
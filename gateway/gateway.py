@@ -28,6 +28,7 @@ CANCEL_REQ_FMT = '<QQ10sB'
 MSG_NEW_ORDER = b'N'[0]
 MSG_SUBSCRIBE = b'Q'[0]
 MSG_SNAPSHOT = b'S'[0]
+MSG_UPDATE = b'U'[0]
 MSG_EXEC_REPORT = b'E'[0]
 MSG_CANCEL_ORDER = b'C'[0]
 
@@ -35,6 +36,7 @@ class GatewayService(trading_pb2_grpc.TradingGatewayServicer):
     def __init__(self):
         self.ome_sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         self.md_streams = []
+        self.l2_books = {}  # symbol -> {'seq', 'bids', 'asks', 'loading'}, mirrored from 'U'
         self.order_id_counter = 0
         self.user_queues = {}
         self.connect_to_ome()
@@ -104,6 +106,8 @@ class GatewayService(trading_pb2_grpc.TradingGatewayServicer):
                     payload = buffer[5:msg_len]
                     if msg_type == MSG_SNAPSHOT:
                         self.handle_snapshot(payload)
+                    elif msg_type == MSG_UPDATE:
+                        self.handle_update(payload)
                     elif msg_type == MSG_EXEC_REPORT:
                         self.handle_execution(payload)
                     buffer = buffer[msg_len:]
@@ -131,6 +135,44 @@ class GatewayService(trading_pb2_grpc.TradingGatewayServicer):
         for q in self.md_streams:
             q.put(snapshot)
 
+    def handle_update(self, payload):
+        sym_raw, seq, flags, n_levels = struct.unpack('<10sQBB', payload[:20])
+        symbol = sym_raw.split(b'\x00')[0].decode('ascii', 'ignore')
+        book = self.l2_books.setdefault(symbol, {'seq': None, 'bids': {}, 'asks': {}, 'loading': False})
+        if flags & 1:  # Snapshot begins: start over
+            book.update(bids={}, asks={}, loading=True)
+        elif not book['loading'] and book['seq'] is not None and seq != book['seq'] + 1:
+            # Missed deltas: subscribing again asks the engine for a fresh snapshot
+            print(f"[Gateway] Gap in {symbol} market data ({book['seq']} -> {seq}), resyncing")
+            book['seq'] = None
+            self.send_to_ome(MSG_SUBSCRIBE, struct.pack(SUB_REQ_FMT, sym_raw, 1))
+            return
+        elif book['seq'] is None and not book['loading']:
+            return  # Waiting for a snapshot
+        book['seq'] = seq
+
+        offset = 20
+        for i in range(n_levels):
+            p, q, side, action = struct.unpack('<dQBB', payload[offset:offset + 18])
+            levels = book['bids'] if side == 0 else book['asks']
+            if action == 2:
+                levels.pop(p, None)
+            else:
+                levels[p] = q
+            offset += 18
+        if flags & 2:
+            book['loading'] = False
+        if book['loading']:
+            return
+
+        snapshot = trading_pb2.MarketDataSnapshot(symbol=symbol)
+        for p in sorted(book['bids'], reverse=True)[:5]:
+            snapshot.bids.append(trading_pb2.PriceLevel(price=p, quantity=book['bids'][p]))
+        for p in sorted(book['asks'])[:5]:
+            snapshot.asks.append(trading_pb2.PriceLevel(price=p, quantity=book['asks'][p]))
+        for q in self.md_streams:
+            q.put(snapshot)
+
     def handle_execution(self, payload):
         if len(payload) < 60: return
         (client_order_id, user_id, exec_id, sym_raw, side, price,
@@ -1,17 +1,27 @@
 #pragma once
 
 #include <../logging/logger.hpp>
+#include <atomic>
 #include <fstream>
+#include <l2_feed.h>
 #include <matching_engine.h>
+#include <mutex>
 #include <protocol.h>
+#include <recv_buffer.h>
 #include <set>
+#include <sharded_engine.h>
 #include <tcp_server.h>
-#include <unordered_map>
+#include <thread>
+#include <optional>
 #include <string>
 
 class ClientGateway {
   public:
-    ClientGateway(MatchingEngine &engine, TcpServer &server);
+    // With `shards`, orders are matched on the shard threads and `engine` only holds
+    // the symbol table; without, they are matched inline on the network thread.
+    // `pipeline` moves encoding and sending of shard results to a dedicated egress thread.
+    ClientGateway(MatchingEngine &engine, TcpServer &server, ShardedEngine *shards = nullptr,
+                  bool pipeline = false);
     ~ClientGateway();
 
     void replayEvents();
@@ -27,6 +37,15 @@ class ClientGateway {
     }
 
   private:
+    // Append a request to the event log for replay
+    template <typename Request> void logEvent(const Request &req) {
+        std::lock_guard<std::mutex> lock(event_log_mutex_); // Egress logs disconnect cancels
+        if (event_log_.is_open()) {
+            event_log_.write(reinterpret_cast<const char *>(&req), sizeof(Request));
+            event_log_.flush();
+        }
+    }
+
     // TcpServer callbacks
     void onMessage(int fd, const char *data, size_t len);
     void onConnection(int fd);
@@ -38,27 +57,123 @@ class ClientGateway {
     void handleMarketDataRequest(int fd, const MarketDataRequest &req);
     void handleNewOrderInternal(const NewOrderRequest &req, int user_id, int fd,
                                 bool is_replay = false);
+    // Intern the symbol and convert the price to ticks; nullopt (and a reject report
+    // unless replaying) if the request is unusable
+    std::optional<Order> decodeOrder(const NewOrderRequest &req, int fd, bool is_replay);
+    void submitOrder(const Order &order, int fd, bool is_replay);
+    void replayCancel(const OrderCancelRequest &req);
     void handleSubscriptionRequest(int fd, const SubscriptionRequest &req);
     void broadcastTradeUpdate(const Trade &update);
     void handleOrderCancel(int fd, const OrderCancelRequest &req);
-    void broadcastMarketData(const std::string& symbol);
+    void handleOrderReplace(int fd, const OrderReplaceRequest &req);
+    void handleMassCancel(int fd, const OrderMassCancelRequest &req);
+    // `session` limits the cancel to orders sent on that session (0 = any)
+    void massCancel(const OrderMassCancelRequest &req, int fd, bool is_replay,
+                    uint32_t session = 0);
+    // Log an order cancelled on behalf of a closed session as a single cancel
+    void logCancel(const Order &order);
+    void handleTradingPhase(int fd, const TradingPhaseRequest &req);
+    void setTradingPhase(const TradingPhaseRequest &req, int fd, bool is_replay);
+    void replaceOrder(const OrderReplaceRequest &req, int fd, bool is_replay);
+
+    struct MarketDataSlot {
+        bool pending = false;      // Listed in market_data_pending_
+        std::vector<int> awaiting; // Subscribers owed a snapshot: new, gap request or backed up
+    };
+    // Queued output above which a subscriber stops getting deltas and is resynced by snapshot
+    static constexpr size_t kMarketDataBacklog = 64 * 1024;
+
+    // Market data is an L2 delta feed, conflated per loop iteration: a change only marks
+    // the symbol, and flushMarketData encodes one batch of level deltas per marked symbol
+    // for all its subscribers, plus a snapshot for each subscriber awaiting one
+    void markMarketData(SymbolId symbol);
+    void flushMarketData();
+    void publishMarketData(SymbolId symbol, MarketDataSlot &slot);
+    // Have the symbol's book report level changes from now on; network thread only
+    void startLevelFeed(SymbolId symbol);
+    MarketDataSnapshot makeSnapshot(SymbolId symbol, const BookTop &top);
+    bool readSnapshot(SymbolId symbol, BookTop &top) const;
+    bool hasSubscribers(SymbolId symbol) const;
+
+    // Reports for a processed order or cancel, whichever thread matched it. `generation` is
+    // the connection's when the command arrived; reports outliving that connection are dropped.
+    void onOrderProcessed(int fd, uint32_t generation, Order order,
+                          const std::vector<Trade> &trades, bool resting, OrderOutcome outcome,
+                          int64_t latency_ns, bool is_replay);
+    void onOrderCancelled(int fd, uint32_t generation, const Order &request,
+                          const char *wire_symbol, const std::optional<Order> &cancelled_order);
+    void onOrderReplaced(int fd, uint32_t generation, const Order &request,
+                         const char *wire_symbol, const std::optional<Order> &replaced,
+                         const std::vector<Trade> &trades);
+    void sendFillReports(int fd, uint32_t generation, Order order,
+                         const std::vector<Trade> &trades, bool resting);
+
+    // Sharded mode: route commands to shards and handle their results
+    void submitToShard(const ShardedEngine::Command &command);
+    void submitToShard(const ShardedEngine::Command &command, size_t shard);
+    size_t pollShards();
+    void runEgress();
+    void onShardEvent(size_t shard, const ShardedEngine::Event &event);
 
     void processPacket(int fd, const char* data);
+    // Handle every complete frame in the session buffer; false if the stream was corrupt
+    bool decodeFrames(int fd, RecvBuffer &buffer);
 
     // Session information
     struct Session {
         int fd;
         bool logged_in = false;
         int user_id    = 0;
-        std::vector<char>buffer;
+        uint32_t id    = 0;                // Tags the orders sent on this session; set at login
+        bool cancel_on_disconnect = false; // Session option from the login request
+        std::vector<UserID> users;         // Owners of the orders sent on this session
+        RecvBuffer buffer;                 // Kept across connections on the same fd
+
+        void reset(int socket) {
+            fd        = socket;
+            logged_in = false;
+            user_id   = 0;
+            id        = 0;
+            cancel_on_disconnect = false;
+            users.clear();
+            buffer.clear();
+        }
     };
 
     TcpServer &server_;
     MatchingEngine &engine_;
-    std::unordered_map<int, Session> sessions_;
-    std::unordered_map<std::string, std::set<int>>
-        market_data_subscriptions_; // symbol -> set of client fds subscribed to
+    std::vector<Session> sessions_; // Indexed by fd
+    uint32_t next_session_id_ = 0;
+    std::vector<std::set<int>>
+        market_data_subscriptions_; // SymbolId -> set of client fds subscribed to
                                     // this symbol
 
+    // Conflated market data, used only by the thread that publishes it: the network
+    // thread, or the egress thread in pipeline mode
+    std::vector<MarketDataSlot> market_data_; // Indexed by SymbolId
+    std::vector<SymbolId> market_data_pending_;
+    L2Feed l2_feed_;
+    std::vector<char> update_buffer_;   // Encoded deltas, reused across flushes
+    std::vector<char> snapshot_buffer_; // Encoded snapshot, reused across flushes
+
+    // Subscribe requests owed a snapshot (symbol, fd), under subscriptions_mutex_
+    std::vector<std::pair<SymbolId, int>> snapshot_requests_;
+    std::atomic<bool> snapshots_requested_{false};
+    std::vector<bool> levels_started_; // Network thread: symbols whose feed was started
+
+    // Fills of the order being handled; reused so matching does not allocate
+    std::vector<Trade> trade_buffer_;
+
+    ShardedEngine *shards_ = nullptr;
+    std::vector<std::vector<Trade>> shard_trades_; // Fills per shard awaiting ORDER_DONE
+
+    // Pipeline mode: the egress thread owns result handling and reads the subscriptions,
+    // which the network thread changes under subscriptions_mutex_
+    bool pipeline_ = false;
+    std::atomic<bool> egress_running_{false};
+    std::thread egress_thread_;
+    std::mutex subscriptions_mutex_;
+
     std::ofstream event_log_;
+    std::mutex event_log_mutex_;
 };
\ No newline at end of file
@@ -21,6 +21,57 @@ class Config {
     std::string log_level = "INFO";
     bool replay_mode      = false;
 
+    // Instrument reference data: default tick plus per-symbol overrides (SYMBOL:TICK)
+    double default_tick_size = 0.01;
+    std::vector<std::pair<std::string, double>> instrument_ticks;
+
+    // Ticks held in each side's contiguous price ladder; prices outside spill to a map
+    size_t book_window_ticks = 16384;
+
+    // Resting orders each book's order index is pre-sized for (grows beyond on demand)
+    size_t order_index_capacity = 16384;
+
+    // Order pool: slots allocated up front, limit on live orders (0 = unbounded), and
+    // whether to touch all pool memory at startup instead of faulting it in on first use
+    size_t order_pool_capacity = 100000;
+    size_t order_pool_limit    = 0;
+    bool prefault_memory       = false;
+
+    // Trades kept in memory; the server spills older ones to this file, next to the event
+    // log by default (empty = dropped), and in sharded mode shard N's to <path>.shard<N>.
+    // Engines built elsewhere (tests, benchmarks) don't spill unless given a path.
+    size_t trade_history_capacity = 65536;
+    std::string trade_spill_path =
+        (std::filesystem::path(PROJECT_ROOT_PATH) / "bins" / "trades.bin").string();
+
+    // Matching threads (0 = match inline on the network thread) and their queue depth
+    size_t shards            = 0;
+    size_t shard_queue_depth = 8192;
+
+    // Send results from a dedicated egress thread (implies at least one shard)
+    bool pipeline = false;
+
+    // Accept ORDER_MASS_CANCEL scope 2, which clears every user's orders in a symbol.
+    // An admin operation, so off by default.
+    bool allow_symbol_mass_cancel = false;
+
+    // Accept TRADING_PHASE requests. Opening or uncrossing an auction affects every
+    // user's orders in the symbol, so this is an admin operation and off by default.
+    bool allow_trading_phase = false;
+
+    // Network loop: spin on epoll instead of sleeping in it, and how long it may sleep
+    // while results from the shards still need polling
+    bool busy_poll      = false;
+    int idle_timeout_us = 100;
+
+    // Network backend: "epoll" or "io_uring" (falls back to epoll if unsupported)
+    std::string io_backend = "epoll";
+
+    // Queued output per connection above which it is reported as a slow consumer
+    size_t send_high_water = 1 << 20;
+    // Queued output per connection above which it is disconnected
+    size_t send_limit = 64 << 20;
+
     void parseArgs(int argc, char *argv[]) {
         for (int i = 0; i < argc; i++) {
             std::string arg(argv[i]);
@@ -30,6 +81,63 @@ class Config {
             } else if (arg == "--log-level" && i + 1 < argc) {
                 log_level = argv[i + 1];
                 i++;
+            } else if (arg == "--tick-size" && i + 1 < argc) {
+                default_tick_size = std::stod(argv[i + 1]);
+                i++;
+            } else if (arg == "--instrument" && i + 1 < argc) {
+                std::string spec(argv[i + 1]);
+                auto colon = spec.find(':');
+                if (colon != std::string::npos) {
+                    instrument_ticks.emplace_back(spec.substr(0, colon),
+                                                  std::stod(spec.substr(colon + 1)));
+                }
+                i++;
+            } else if (arg == "--book-window" && i + 1 < argc) {
+                book_window_ticks = std::stoul(argv[i + 1]);
+                i++;
+            } else if (arg == "--order-index-capacity" && i + 1 < argc) {
+                order_index_capacity = std::stoul(argv[i + 1]);
+                i++;
+            } else if (arg == "--order-pool-capacity" && i + 1 < argc) {
+                order_pool_capacity = std::stoul(argv[i + 1]);
+                i++;
+            } else if (arg == "--order-pool-limit" && i + 1 < argc) {
+                order_pool_limit = std::stoul(argv[i + 1]);
+                i++;
+            } else if (arg == "--trade-history" && i + 1 < argc) {
+                trade_history_capacity = std::stoul(argv[i + 1]);
+                i++;
+            } else if (arg == "--trade-spill" && i + 1 < argc) {
+                trade_spill_path = argv[i + 1];
+                i++;
+            } else if (arg == "--shards" && i + 1 < argc) {
+                shards = std::stoul(argv[i + 1]);
+                i++;
+            } else if (arg == "--shard-queue-depth" && i + 1 < argc) {
+                shard_queue_depth = std::stoul(argv[i + 1]);
+                i++;
+            } else if (arg == "--pipeline") {
+                pipeline = true;
+            } else if (arg == "--allow-symbol-mass-cancel") {
+                allow_symbol_mass_cancel = true;
+            } else if (arg == "--allow-trading-phase") {
+                allow_trading_phase = true;
+            } else if (arg == "--busy-poll") {
+                busy_poll = true;
+            } else if (arg == "--io-backend" && i + 1 < argc) {
+                io_backend = argv[i + 1];
+                i++;
+            } else if (arg == "--idle-timeout-us" && i + 1 < argc) {
+                idle_timeout_us = std::stoi(argv[i + 1]);
+                i++;
+            } else if (arg == "--send-high-water" && i + 1 < argc) {
+                send_high_water = std::stoull(argv[i + 1]);
+                i++;
+            } else if (arg == "--send-limit" && i + 1 < argc) {
+                send_limit = std::stoull(argv[i + 1]);
+                i++;
+            } else if (arg == "--prefault") {
+                prefault_memory = true;
             } else if (arg == "--replay-mode") {
                 replay_mode = true;
             } else if (arg == "--help") {
@@ -46,6 +154,27 @@ class Config {
                   << "  --port <port>           Set the server port (default: 8080)\n"
                   << "  --log-level <level>    Set log level (DEBUG, INFO, WARN, ERROR)\n"
                   << "  --replay-mode          Enable replay mode to process historical events\n"
+                  << "  --tick-size <tick>     Default price increment for symbols (default: 0.01)\n"
+                  << "  --instrument <SYM:TICK> Set the price increment for one symbol\n"
+                  << "  --book-window <ticks>  Price ladder window per book side (default: 16384)\n"
+                  << "  --order-index-capacity <n> Resting orders per book before the index grows\n"
+                  << "  --order-pool-capacity <n> Orders pre-allocated at startup (default: 100000)\n"
+                  << "  --order-pool-limit <n> Maximum live orders, 0 for no limit (default: 0)\n"
+                  << "  --prefault             Touch pool memory at startup to avoid page faults\n"
+                  << "  --trade-history <n>    Trades kept in memory (default: 65536)\n"
+                  << "  --trade-spill <file>   Memory-mapped file for older trades (default:\n"
+                  << "                         bins/trades.bin, \"\" to drop them); with shards,\n"
+                  << "                         one <file>.shard<n> per shard\n"
+                  << "  --shards <n>           Matching threads, symbols split across them (default: 0)\n"
+                  << "  --shard-queue-depth <n> Commands/results buffered per shard (default: 8192)\n"
+                  << "  --pipeline             Split network, matching and egress onto separate threads\n"
+                  << "  --allow-symbol-mass-cancel Accept mass cancels of all users' orders in a symbol\n"
+                  << "  --allow-trading-phase  Accept requests to start or uncross a call auction\n"
+                  << "  --busy-poll            Spin on socket readiness instead of sleeping (one core)\n"
+                  << "  --io-backend <name>    Network backend: epoll or io_uring (default: epoll)\n"
+                  << "  --idle-timeout-us <us> Longest sleep while shard results need polling (default: 100)\n"
+                  << "  --send-high-water <bytes> Queued output that flags a slow client (default: 1048576)\n"
+                  << "  --send-limit <bytes>   Queued output that disconnects a client (default: 67108864)\n"
                   << "  --help                 Show this help message\n";
         exit(0);
     }
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 64-bit finaliser (MurmurHash3 fmix64). Sequential IDs must spread over both the
+// probe position and the 7-bit tag, so identity hashing is not good enough.
+struct MixHash {
+    size_t operator()(uint64_t key) const {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb53fe1a85ec3ULL;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+};
+
+/**
+ * Open-addressing hash map with a SwissTable-style control byte per slot.
+ *
+ * Each control byte is either kEmpty or the low 7 bits of the key's hash, and a
+ * lookup compares 16 control bytes at once (SSE2) before touching any key. Probing
+ * is linear, and erase uses backward-shift deletion, so the table never accumulates
+ * tombstones under cancel-heavy churn. Keys and values are stored inline; both
+ * should be small trivially copyable types (IDs and pointers).
+ */
+template <typename K, typename V, typename Hash = MixHash> class FlatHashMap {
+  public:
+    explicit FlatHashMap(size_t expected_size = 0) {
+        reserve(expected_size);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    size_t capacity() const {
+        return slots_.size();
+    }
+
+    /**
+     * Make room for `n` entries without rehashing.
+     * Capacity is kept a power of two with a maximum load factor of 7/8.
+     */
+    void reserve(size_t n) {
+        size_t wanted = kGroupWidth;
+        while (wanted - wanted / 8 < n) {
+            wanted *= 2;
+        }
+        if (wanted > slots_.size()) {
+            rehash(wanted);
+        }
+    }
+
+    /**
+     * Look up a key.
+     * @return Pointer to the stored value, or nullptr if the key is absent.
+     */
+    V *find(const K &key) {
+        size_t idx = find_index(key);
+        return idx == npos ? nullptr : &slots_[idx].second;
+    }
+
+    const V *find(const K &key) const {
+        size_t idx = find_index(key);
+        return idx == npos ? nullptr : &slots_[idx].second;
+    }
+
+    // Start loading the control group and first slot a lookup or insert of `key` will probe
+    void prefetch(const K &key) const {
+        if (slots_.empty()) {
+            return;
+        }
+        size_t pos = Hash{}(key) >> 7 & (slots_.size() - 1);
+        __builtin_prefetch(ctrl_.data() + pos);
+        __builtin_prefetch(slots_.data() + pos);
+    }
+
+    bool contains(const K &key) const {
+        return find_index(key) != npos;
+    }
+
+    /**
+     * Insert a key or overwrite its value.
+     * @return true if the key was newly inserted.
+     */
+    bool insert_or_assign(const K &key, const V &value) {
+        size_t idx = find_index(key);
+        if (idx != npos) {
+            slots_[idx].second = value;
+            return false;
+        }
+        if (size_ + 1 > slots_.size() - slots_.size() / 8) {
+            rehash(slots_.size() * 2);
+        }
+        place(key, value);
+        ++size_;
+        return true;
+    }
+
+    /**
+     * Remove a key, shifting later entries of the probe run back into the hole.
+     * @return true if the key was present.
+     */
+    bool erase(const K &key) {
+        size_t hole = find_index(key);
+        if (hole == npos) {
+            return false;
+        }
+        size_t mask = slots_.size() - 1;
+        size_t next = (hole + 1) & mask;
+        while (ctrl_[next] != kEmpty) {
+            size_t home = Hash{}(slots_[next].first) >> 7 & mask;
+            // Move the entry back only if the hole lies on its probe path
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                slots_[hole] = slots_[next];
+                set_ctrl(hole, ctrl_[next]);
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+        set_ctrl(hole, kEmpty);
+        --size_;
+        return true;
+    }
+
+    void clear() {
+        std::fill(ctrl_.begin(), ctrl_.end(), kEmpty);
+        size_ = 0;
+    }
+
+  private:
+    static constexpr int8_t kEmpty      = -128; // 0b10000000; full slots hold 0..127
+    static constexpr size_t kGroupWidth = 16;
+    static constexpr size_t npos        = static_cast<size_t>(-1);
+
+    // Bit i of the result is set if control byte i of the group equals `tag`
+    static uint32_t match(const int8_t *group, int8_t tag) {
+#if defined(__SSE2__)
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+            bits |= static_cast<uint32_t>(group[i] == tag) << i;
+        }
+        return bits;
+#endif
+    }
+
+    size_t find_index(const K &key) const {
+        if (size_ == 0) {
+            return npos;
+        }
+        size_t hash = Hash{}(key);
+        auto tag    = static_cast<int8_t>(hash & 0x7f);
+        size_t mask = slots_.size() - 1;
+        size_t pos  = hash >> 7 & mask;
+        while (true) {
+            const int8_t *group = ctrl_.data() + pos;
+            uint32_t empties    = match(group, kEmpty);
+            uint32_t hits       = match(group, tag);
+            if (empties) {
+                hits &= (empties & (0u - empties)) - 1; // Probe run ends at the first empty
+            }
+            while (hits) {
+                size_t idx = (pos + static_cast<size_t>(std::countr_zero(hits))) & mask;
+                if (slots_[idx].first == key) {
+                    return idx;
+                }
+                hits &= hits - 1;
+            }
+            if (empties) {
+                return npos;
+            }
+            pos = (pos + kGroupWidth) & mask;
+        }
+    }
+
+    // Store a key known to be absent in the first empty slot of its probe run
+    void place(const K &key, const V &value) {
+        size_t hash = Hash{}(key);
+        size_t mask = slots_.size() - 1;
+        size_t pos  = hash >> 7 & mask;
+        while (true) {
+            uint32_t empties = match(ctrl_.data() + pos, kEmpty);
+            if (empties) {
+                size_t idx  = (pos + static_cast<size_t>(std::countr_zero(empties))) & mask;
+                slots_[idx] = {key, value};
+                set_ctrl(idx, static_cast<int8_t>(hash & 0x7f));
+                return;
+            }
+            pos = (pos + kGroupWidth) & mask;
+        }
+    }
+
+    // The first kGroupWidth control bytes are mirrored past the end so a group
+    // load starting near the end of the table wraps around without a branch
+    void set_ctrl(size_t idx, int8_t value) {
+        ctrl_[idx] = value;
+        if (idx < kGroupWidth) {
+            ctrl_[slots_.size() + idx] = value;
+        }
+    }
+
+    void rehash(size_t new_capacity) {
+        std::vector<std::pair<K, V>> old_slots = std::move(slots_);
+        std::vector<int8_t> old_ctrl           = std::move(ctrl_);
+
+        slots_.assign(new_capacity, {});
+        ctrl_.assign(new_capacity + kGroupWidth, kEmpty);
+        for (size_t i = 0; i < old_slots.size(); ++i) {
+            if (old_ctrl[i] != kEmpty) {
+                place(old_slots[i].first, old_slots[i].second);
+            }
+        }
+    }
+
+    std::vector<std::pair<K, V>> slots_;
+    std::vector<int8_t> ctrl_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <types.h>
+#include <unordered_map>
+
+/**
+ * Static reference data for a tradable symbol.
+ *
+ * Prices travel on the wire as doubles, but inside the engine every price is an
+ * integer number of ticks. A quoted price p maps to llround(p * price_scale) / tick_size.
+ */
+struct Instrument {
+    Symbol symbol;
+    int64_t price_scale = 100; // Fixed-point units per 1.0 of quoted price (100 = cents)
+    int64_t tick_size   = 1;   // Minimum price increment, in price_scale units
+
+    Price to_ticks(double price) const {
+        return std::llround(price * static_cast<double>(price_scale)) / tick_size;
+    }
+
+    double to_price(Price ticks) const {
+        return static_cast<double>(ticks * tick_size) / static_cast<double>(price_scale);
+    }
+
+    // True if the quoted price lies exactly on the tick grid
+    bool is_on_tick(double price) const {
+        double scaled = price * static_cast<double>(price_scale);
+        int64_t units = std::llround(scaled);
+        return std::fabs(scaled - static_cast<double>(units)) < 1e-6 && units % tick_size == 0;
+    }
+
+    /**
+     * Build an instrument from a decimal tick size such as 0.01 or 0.25.
+     * The price scale is the smallest power of ten that makes the tick an integer.
+     */
+    static Instrument fromTickSize(const Symbol &symbol, double tick) {
+        Instrument inst;
+        inst.symbol      = symbol;
+        inst.price_scale = 1;
+        while (inst.price_scale < 1000000000 &&
+               std::fabs(tick * inst.price_scale - std::llround(tick * inst.price_scale)) > 1e-9) {
+            inst.price_scale *= 10;
+        }
+        inst.tick_size = std::max<int64_t>(1, std::llround(tick * inst.price_scale));
+        return inst;
+    }
+};
+
+class InstrumentRegistry {
+  public:
+    InstrumentRegistry() = default;
+
+    void add(const Instrument &instrument) {
+        instruments_[instrument.symbol] = instrument;
+    }
+
+    /**
+     * Look up reference data for a symbol.
+     * Unknown symbols are registered on first use with the default tick grid.
+     */
+    const Instrument &get(const Symbol &symbol) {
+        auto it = instruments_.find(symbol);
+        if (it != instruments_.end()) {
+            return it->second;
+        }
+        Instrument inst = default_;
+        inst.symbol     = symbol;
+        return instruments_.emplace(symbol, inst).first->second;
+    }
+
+    void setDefault(const Instrument &instrument) {
+        default_ = instrument;
+    }
+
+  private:
+    Instrument default_;
+    std::unordered_map<Symbol, Instrument> instruments_;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tcp_server.h>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+/**
+ * io_uring event loop for TcpServer, driven through raw syscalls (no liburing).
+ *
+ * A multishot accept and one multishot receive per connection stay armed in the
+ * kernel, so nothing is re-armed per message. Receives land in a provided buffer ring
+ * and each buffer is handed back as soon as the message callback returns. Accepted
+ * sockets are installed in the ring's registered file table (at index == fd), which
+ * spares receives and sends the per-operation file lookup. Packets sent from the loop
+ * thread are appended to a per-connection buffer and leave as one SEND per connection
+ * per iteration, submitted in the same io_uring_enter that waits for completions.
+ * A poll on the server's wakeup eventfd ends the wait when another thread hands the
+ * loop packets to send.
+ */
+class IoUringBackend {
+  public:
+    static constexpr unsigned kQueueDepth  = 1024; // Submission queue entries
+    static constexpr unsigned kBufferCount = 1024; // Provided receive buffers
+    static constexpr size_t kBufferSize    = 4096;
+    static constexpr unsigned kMaxFiles    = 65536; // Registered file table, capped by RLIMIT_NOFILE
+
+    /**
+     * Set up a ring serving `listen_fd`; a write to the eventfd `wake_fd` ends a wait.
+     * @return nullptr if io_uring or a feature it needs (multishot receive, provided
+     *         buffer rings: Linux 6.0) is unavailable; the caller falls back to epoll.
+     */
+    static std::unique_ptr<IoUringBackend> create(int listen_fd, int wake_fd);
+    ~IoUringBackend();
+
+    IoUringBackend(const IoUringBackend &)            = delete;
+    IoUringBackend &operator=(const IoUringBackend &) = delete;
+
+    /**
+     * One loop iteration: submit queued sends, wait for completions and dispatch them.
+     * Loop thread only.
+     * @param timeout_us 0 to return at once, -1 to wait for the first completion.
+     */
+    void poll(int timeout_us, const TcpServer::OnConnection &on_connection,
+              const TcpServer::OnMessage &on_message,
+              const TcpServer::OnDisconnection &on_disconnection);
+
+    // Queue a packet for `fd`; it goes out with the next poll. Loop thread only.
+    // Returns the bytes queued for the connection, including any SEND in flight.
+    size_t send(int fd, const char *data, size_t len);
+
+    // Drop what is queued for `fd` and not yet submitted. Loop thread only.
+    void discard(int fd);
+
+    // Also store each connection's queued() in counts[fd] whenever it changes, so other
+    // threads can read it; fds at or past `size` are not mirrored
+    void mirrorQueued(std::atomic<size_t> *counts, size_t size) {
+        mirror_      = counts;
+        mirror_size_ = size;
+    }
+
+    // Bytes queued for `fd`, including any SEND in flight. Loop thread only.
+    size_t queued(int fd) const {
+        if (fd < 0 || static_cast<size_t>(fd) >= connections_.size()) {
+            return 0;
+        }
+        const Connection &conn = connections_[fd];
+        return conn.pending.size() + conn.inflight.size() - conn.inflight_sent;
+    }
+
+  private:
+    struct Connection {
+        bool open    = false;
+        bool fixed   = false; // Installed in the registered file table
+        bool queued  = false; // Listed in dirty_
+        bool sending = false; // The kernel owns `inflight` until its SEND completes
+        bool closing = false; // Closed by the peer; release once the SEND completes
+        std::vector<char> pending;  // Queued since the last SEND was issued
+        std::vector<char> inflight; // Bytes of the outstanding SEND
+        size_t inflight_sent = 0;
+    };
+
+    IoUringBackend() = default;
+    bool init(int listen_fd, int wake_fd);
+
+    io_uring_sqe *nextSqe();
+    void enter(int timeout_us);
+    void armAccept();
+    void armRecv(int fd);
+    void armWake();
+    void flushSends();
+    void recycleBuffer(unsigned bid);
+    bool installFile(int index, int fd);
+    void openConnection(int fd, const TcpServer::OnConnection &on_connection);
+    void closeConnection(int fd, const TcpServer::OnDisconnection &on_disconnection);
+    void releaseConnection(int fd);
+    void onSent(int fd, int result);
+    void publish(int fd);
+
+    int ring_fd_   = -1;
+    int listen_fd_ = -1;
+    int wake_fd_   = -1;
+
+    // Ring mappings shared with the kernel
+    void *ring_       = nullptr;
+    size_t ring_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_   = 0;
+
+    // Submission queue: the kernel advances head, we advance tail
+    unsigned *sq_head_  = nullptr;
+    unsigned *sq_tail_  = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned sq_mask_   = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+
+    // Completion queue: the kernel advances tail, we advance head
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned cq_mask_  = 0;
+    io_uring_cqe *cqes_ = nullptr;
+
+    // Provided receive buffers and the ring that hands them to the kernel
+    io_uring_buf_ring *buf_ring_ = nullptr;
+    char *buffers_               = nullptr;
+    uint16_t buf_tail_           = 0;
+
+    unsigned max_files_ = 0; // Registered file slots; fds at or above use plain lookups
+    std::vector<Connection> connections_; // Indexed by fd
+    std::vector<int> dirty_;              // Connections with output to send
+    std::atomic<size_t> *mirror_ = nullptr;
+    size_t mirror_size_          = 0;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <instrument.h>
+#include <map>
+#include <protocol.h>
+#include <types.h>
+#include <vector>
+
+/**
+ * Gateway side of the incremental L2 market-data feed.
+ *
+ * Keeps a full-depth mirror of each fed symbol's book from the level changes the
+ * matching side reports (OrderBook::drain_level_updates). Changes accumulate between
+ * publishes and are encoded as MarketDataUpdate messages, one per level that actually
+ * moved, each message taking the symbol's next sequence number. Snapshots are encoded
+ * from the mirror, so they never go back to the book or its thread.
+ *
+ * Single-threaded: it belongs to the thread that publishes market data.
+ */
+class L2Feed {
+  public:
+    // Padded symbol as sent in MarketDataUpdate::symbol
+    using WireSymbol = char[sizeof(MarketDataUpdate::symbol)];
+
+    // True once the symbol's mirror holds the whole book
+    bool ready(SymbolId symbol) const {
+        return symbol < books_.size() && books_[symbol].ready;
+    }
+
+    // The mirror is complete: the seeding ADDs are in, and later updates are deltas
+    void set_ready(SymbolId symbol);
+
+    // Apply one level change to the mirror
+    void apply(SymbolId symbol, const LevelUpdate &update);
+
+    /**
+     * Append the delta messages for everything that changed since the last call.
+     * @return Number of messages appended (0 if no level moved).
+     */
+    size_t encode_updates(SymbolId symbol, const WireSymbol &wire_symbol, const Instrument &inst,
+                          std::vector<char> &out);
+
+    // Append a snapshot of the mirror: Adds for every level, sequence number of the last delta
+    void encode_snapshot(SymbolId symbol, const WireSymbol &wire_symbol, const Instrument &inst,
+                         std::vector<char> &out) const;
+
+    uint64_t sequence(SymbolId symbol) const {
+        return symbol < books_.size() ? books_[symbol].seq : 0;
+    }
+
+  private:
+    // A level touched since the last publish and its total before the first touch
+    struct Change {
+        OrderSide side;
+        Price price;
+        Quantity before;
+    };
+
+    struct Book {
+        bool ready   = false;
+        uint64_t seq = 0; // Last delta message sent
+        std::map<Price, Quantity, std::greater<Price>> bids;
+        std::map<Price, Quantity> asks;
+        std::vector<Change> changes;
+
+        Quantity quantity(OrderSide side, Price price) const;
+    };
+
+    Book &book(SymbolId symbol);
+
+    // Appends messages of up to MarketDataUpdate::kMaxLevels levels each
+    class Encoder;
+
+    std::vector<Book> books_; // Indexed by SymbolId
+};
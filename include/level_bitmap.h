@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Hierarchical occupancy bitmap: one bit per slot at the bottom level and one
+ * summary bit per non-zero word on each level above it, up to a single root word.
+ *
+ * Finding the next or previous set slot costs one count-trailing/leading-zeros per
+ * level, so a 262144-slot ladder is searched in three word operations regardless
+ * of how sparse it is.
+ */
+class LevelBitmap {
+  public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit LevelBitmap(size_t size) : size_(size) {
+        size_t bits = size ? size : 1;
+        do {
+            size_t words = (bits + 63) / 64;
+            levels_.emplace_back(words, 0);
+            bits = words;
+        } while (bits > 1);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool test(size_t i) const {
+        return (levels_[0][i >> 6] >> (i & 63)) & 1;
+    }
+
+    void set(size_t i) {
+        for (auto &level : levels_) {
+            uint64_t &word = level[i >> 6];
+            bool was_empty = word == 0;
+            word |= uint64_t{1} << (i & 63);
+            if (!was_empty) {
+                return; // Parents already mark this word as occupied
+            }
+            i >>= 6;
+        }
+    }
+
+    void clear(size_t i) {
+        for (auto &level : levels_) {
+            uint64_t &word = level[i >> 6];
+            word &= ~(uint64_t{1} << (i & 63));
+            if (word != 0) {
+                return; // Word still occupied, parents unchanged
+            }
+            i >>= 6;
+        }
+    }
+
+    void reset() {
+        for (auto &level : levels_) {
+            std::fill(level.begin(), level.end(), 0);
+        }
+    }
+
+    bool none() const {
+        return levels_.back()[0] == 0;
+    }
+
+    /**
+     * Find the lowest set slot at or after `i`.
+     * @return Slot index, or npos if there is none.
+     */
+    size_t find_next(size_t i) const {
+        if (i >= size_) {
+            return npos;
+        }
+        size_t level = 0;
+        while (true) {
+            size_t w      = i >> 6;
+            uint64_t word = levels_[level][w] & (~uint64_t{0} << (i & 63));
+            if (word) {
+                i = (w << 6) | static_cast<size_t>(std::countr_zero(word));
+                break;
+            }
+            // Nothing left in this word; continue from the next word one level up
+            i = w + 1;
+            if (++level == levels_.size() || i >= levels_[level - 1].size()) {
+                return npos;
+            }
+        }
+        while (level > 0) {
+            --level;
+            i = (i << 6) | static_cast<size_t>(std::countr_zero(levels_[level][i]));
+        }
+        return i;
+    }
+
+    /**
+     * Find the highest set slot at or before `i`.
+     * @return Slot index, or npos if there is none.
+     */
+    size_t find_prev(size_t i) const {
+        if (i == npos) {
+            return npos;
+        }
+        if (i >= size_) {
+            i = size_ - 1;
+        }
+        size_t level = 0;
+        while (true) {
+            size_t w      = i >> 6;
+            unsigned b    = i & 63;
+            uint64_t mask = b == 63 ? ~uint64_t{0} : (uint64_t{2} << b) - 1;
+            uint64_t word = levels_[level][w] & mask;
+            if (word) {
+                i = (w << 6) | static_cast<size_t>(63 - std::countl_zero(word));
+                break;
+            }
+            // Nothing left in this word; continue from the previous word one level up
+            if (w == 0 || ++level == levels_.size()) {
+                return npos;
+            }
+            i = w - 1;
+        }
+        while (level > 0) {
+            --level;
+            i = (i << 6) | static_cast<size_t>(63 - std::countl_zero(levels_[level][i]));
+        }
+        return i;
+    }
+
+  private:
+    size_t size_;
+    std::vector<std::vector<uint64_t>> levels_; // levels_[0] = one bit per slot
+};
@@ -1,34 +1,183 @@
 #pragma once
 
 #include <atomic>
+#include <config.h>
+#include <flat_hash_map.h>
+#include <instrument.h>
 #include <object_pool.h>
 #include <optional>
+#include <memory>
 #include <order_book.h>
+#include <span>
+#include <symbol_table.h>
+#include <trade_history.h>
+#include <type_traits>
 #include <types.h>
-#include <unordered_map>
 #include <vector>
 
+/**
+ * Non-owning reference to a callable that receives each trade as it is executed.
+ *
+ * Lets the engine hand fills straight to the caller (gateway, benchmark, test)
+ * without collecting them in a container first. The callable must outlive the
+ * call it is passed to; nothing is copied or allocated.
+ */
+class TradeSink {
+  public:
+    template <typename Fn>
+        requires(!std::is_same_v<std::remove_cvref_t<Fn>, TradeSink> &&
+                 std::is_invocable_v<Fn &, const Trade &>)
+    TradeSink(Fn &&fn) // NOLINT(google-explicit-constructor): callables convert implicitly
+        : ctx_(const_cast<void *>(static_cast<const void *>(std::addressof(fn)))),
+          call_([](void *ctx, const Trade &trade) {
+              (*static_cast<std::remove_reference_t<Fn> *>(ctx))(trade);
+          }) {
+    }
+
+    void operator()(const Trade &trade) const {
+        call_(ctx_, trade);
+    }
+
+  private:
+    void *ctx_;
+    void (*call_)(void *, const Trade &);
+};
+
+// Result of matching one incoming order
+struct OrderResult {
+    OrderOutcome outcome = OrderOutcome::ACCEPTED;
+    size_t trades        = 0; // Number of trades executed
+};
+
 class MatchingEngine {
   public:
-    // Pre-allocate pool for 100k orders
-    MatchingEngine() : order_pool_(100000) {
+    // Pre-allocate the order pool as configured; it grows by slabs up to its limit.
+    // Trades evicted from the in-memory history go to `trade_spill_path` (empty = dropped).
+    // Each engine needs its own spill file, since opening one truncates it.
+    explicit MatchingEngine(const std::string &trade_spill_path = {})
+        : order_pool_(Config::getInstance().order_pool_capacity,
+                      Config::getInstance().order_pool_limit,
+                      Config::getInstance().prefault_memory),
+          symbols_(instruments_),
+          trade_history_(Config::getInstance().trade_history_capacity, trade_spill_path),
+          published_books_(new std::atomic<const OrderBook *>[SymbolTable::kMaxSymbols]()) {
+        order_meta_.resize(order_pool_.capacity());
     }
 
     // Main operations
     std::vector<Trade> process_new_order(const Order &order);
 
+    /**
+     * Match an order, passing each trade to `on_trade` as it executes.
+     * Does not allocate once the pool, books and indexes are warm.
+     * @return Whether the order was accepted, and the number of trades executed.
+     */
+    OrderResult process_new_order(const Order &order, TradeSink on_trade);
+
+    /**
+     * Match a batch of orders (replay, backtests, bulk loads), passing every fill to
+     * `on_trade`. Orders are grouped by book, so each book is looked up once and the
+     * levels and index slots of the next order are prefetched while the current one
+     * matches. Orders for the same symbol keep their relative order, so every book ends
+     * up exactly as if the orders had been processed one at a time; fills of different
+     * symbols may be reported in a different interleaving.
+     * @return Number of trades executed.
+     */
+    size_t process_orders(std::span<const Order> orders, TradeSink on_trade);
+
     // Pre-trade validations
     bool validate_order(const Order &order);
 
     // Order management
-    std::optional<Order> cancel_order(const OrderID &order_id, const Symbol &symbol, int side);
+    std::optional<Order> cancel_order(const OrderID &order_id, SymbolId symbol, int side);
+
+    /**
+     * Cancel every resting order of a user, optionally only those in one symbol.
+     * Walks the user's own order list, so the cost is proportional to the number of
+     * orders the user has resting, not to the size of the books.
+     * @param symbol Only cancel orders in this symbol; kInvalidSymbol for all symbols.
+     * @param session Only cancel orders sent on this gateway session; 0 for any session.
+     * @return The cancelled orders.
+     */
+    std::vector<Order> mass_cancel(UserID user_id, SymbolId symbol = kInvalidSymbol,
+                                   uint32_t session = 0);
+
+    // Cancel every resting order in a symbol, whoever owns it
+    std::vector<Order> cancel_all(SymbolId symbol);
+
+    /**
+     * Cancel/replace a resting order in one step, without giving up its pool slot or
+     * index entry. A smaller quantity at the same price is applied in place and keeps
+     * queue priority. A new price or a larger quantity moves the order to the back of
+     * its new level, matching first if the new price crosses; fills go to `on_trade`.
+     * A quantity at or below what is already filled cancels the order.
+     * @param quantity New total quantity, including anything already filled.
+     * @return The order after the replace, or nullopt if it is not resting or the
+     *         new price is invalid.
+     */
+    std::optional<Order> modify_order(const OrderID &order_id, SymbolId symbol, Price price,
+                                      Quantity quantity, TradeSink on_trade);
+
+    /**
+     * Switch a symbol to its auction phase (opening or closing call). Limit orders then
+     * rest without matching, so the book may cross; orders that must execute at once
+     * (MARKET, IOC, FOK) are rejected. Replaces re-queue without matching.
+     */
+    void begin_auction(SymbolId symbol);
+
+    /**
+     * End a symbol's auction: execute everything that crosses at the single
+     * equilibrium price (OrderBook::find_uncross), best bids against best asks in
+     * price-time priority, and resume continuous matching. Fills go to `on_trade`.
+     * @return Number of trades executed.
+     */
+    size_t uncross(SymbolId symbol, TradeSink on_trade);
 
     // Order book access
+    OrderBook &get_or_create_order_book(SymbolId symbol);
+    OrderBook *get_order_book(SymbolId symbol);
+
+    // Convenience overloads by name (intern / look up the symbol first; not for the hot path)
     OrderBook &get_or_create_order_book(const Symbol &symbol);
     OrderBook *get_order_book(const Symbol &symbol);
 
-    // Query methods
-    const std::vector<Trade> &getTradeHistory() const {
+    /**
+     * Latest top of book published for a symbol. Every call that changes a book
+     * republishes it when done, so this may be called from any thread, without locks
+     * and without touching the live book.
+     * @return false if the symbol has no book yet.
+     */
+    bool read_snapshot(SymbolId symbol, BookTop &top) const {
+        if (symbol >= SymbolTable::kMaxSymbols) {
+            return false;
+        }
+        const OrderBook *book = published_books_[symbol].load(std::memory_order_acquire);
+        if (!book) {
+            return false;
+        }
+        top = book->snapshot();
+        return true;
+    }
+
+    // Instrument reference data (tick size and price scale per symbol)
+    InstrumentRegistry &instruments() {
+        return instruments_;
+    }
+
+    // Symbol name <-> dense id mapping shared with the gateway
+    SymbolTable &symbols() {
+        return symbols_;
+    }
+
+    // Query methods: trade history by sequence number [first, last) or timestamp [from, to);
+    // ranges reaching past tradeHistory().first_available() come back truncated
+    std::vector<Trade> getTradesBySequence(uint64_t first, uint64_t last) const {
+        return trade_history_.range_by_sequence(first, last);
+    }
+    std::vector<Trade> getTradesByTime(Timestamp from, Timestamp to) const {
+        return trade_history_.range_by_time(from, to);
+    }
+    const TradeHistory &tradeHistory() const {
         return trade_history_;
     }
 
@@ -47,25 +196,94 @@ class MatchingEngine {
     void resetStats();
 
   private:
-    // Pool for managing Order objects
-    ObjectPool<Order> order_pool_;
+    // Pool for the hot, cache-line sized part of resting orders
+    ObjectPool<RestingOrder> order_pool_;
+
+    // Cold order data, parallel to the pool and indexed by RestingOrder::slot
+    std::vector<OrderMeta> order_meta_;
 
-    // Order books mapped by Symbol
-    std::unordered_map<Symbol, OrderBook> order_books_;
+    // Reference data used to convert wire prices to ticks
+    InstrumentRegistry instruments_;
 
-    // Trade history
-    std::vector<Trade> trade_history_;
+    // Interned symbols; ids index order_books_
+    SymbolTable symbols_;
+
+    // Order books indexed by SymbolId (null until the first order for the symbol)
+    std::vector<std::unique_ptr<OrderBook>> order_books_;
+
+    // Trade history: recent trades in memory, older ones spilled to disk
+    TradeHistory trade_history_;
 
     // Engine statistics
     Stats stats_;
 
+    // Books by SymbolId for snapshot readers on other threads; order_books_ may
+    // reallocate, this array never does and books live as long as the engine
+    std::unique_ptr<std::atomic<const OrderBook *>[]> published_books_;
+
+    // Head slot of each user's list of resting orders (links live in OrderMeta)
+    FlatHashMap<UserID, uint32_t> user_orders_;
+
+    // Scratch for process_orders: positions of the valid orders, as given and grouped
+    // by symbol, and the per-symbol offsets used to group them
+    std::vector<uint32_t> batch_valid_;
+    std::vector<uint32_t> batch_order_;
+    std::vector<uint32_t> batch_offsets_;
+
     // Helper methods
-    std::vector<Trade> match_against_buy_orders(OrderBook &book, Order *sell_order);
-    std::vector<Trade> match_against_sell_orders(OrderBook &book, Order *buy_order);
+    // Match a validated order against its book and rest or release the remainder
+    OrderResult execute_order(OrderBook &book, const Order &order, TradeSink on_trade);
+
+    /**
+     * Matching kernel for a taker on side S with order type T (LIMIT, MARKET or IOC).
+     * The book side, price comparison and market/limit check are fixed at compile
+     * time, so each instantiation is a straight sweep of the opposite side's best levels.
+     */
+    template <OrderSide S, OrderType T>
+    size_t match(OrderBook &book, RestingOrder *taker, TradeSink on_trade);
+
+    // Match, then rest (LIMIT) or release (MARKET, IOC) the remainder
+    template <OrderSide S, OrderType T>
+    size_t execute(OrderBook &book, RestingOrder *taker, TradeSink on_trade);
+
+    // Where a feasible FOK sweep ends: the last level it needs and what it takes there
+    struct FokBound {
+        Price last_price  = 0;
+        Quantity last_qty = 0;
+    };
+
+    /**
+     * Sweep for a FOK taker on side S, to the bound found by can_fill_completely. The
+     * levels before the bound are taken whole and the bound level up to its quantity,
+     * so the book is not checked again while sweeping.
+     */
+    template <OrderSide S>
+    size_t sweep_fok(OrderBook &book, RestingOrder *taker, FokBound bound, TradeSink on_trade);
+
+    // Execute `qty` between a taker on side S and a resting maker, at the maker's price
+    template <OrderSide S>
+    void fill(OrderBook &book, RestingOrder *taker, RestingOrder *maker, Quantity qty,
+              TradeSink on_trade);
+
+    Trade create_trade(RestingOrder *buy_order, RestingOrder *sell_order,
+                       Quantity trade_quantity, Price trade_price);
+
+    // Take a pool slot for an incoming order and split it into hot and cold parts
+    RestingOrder *allocate_order(const Order &order);
+
+    // Return an order's slot to the pool, unlinking it from its user's list
+    void release_order(RestingOrder *order);
+
+    // Add a newly resting order to the front of its user's list / take it off
+    void link_user_order(uint32_t slot);
+    void unlink_user_order(uint32_t slot);
 
-    Trade create_trade(Order *buy_order, Order *sell_order, Quantity trade_quantity,
-                       Price trade_price);
+    // Reassemble the full order from its hot and cold parts
+    Order to_order(const RestingOrder &order) const;
 
-    // Check if order can be completely filled
-    bool can_fill_completely(const OrderBook &book, const Order &order);
+    // Check if a taker on side S for `quantity` up to `price` can be completely filled,
+    // and if so where its sweep ends
+    template <OrderSide S>
+    bool can_fill_completely(const OrderBook &book, Price price, Quantity quantity,
+                             FokBound &bound) const;
 };
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Bounded lock-free queue for any number of producer threads and one consumer.
+ *
+ * Each cell carries a sequence number that says whether it is free for the
+ * producer claiming position `pos` (sequence == pos) or holds a value for the
+ * consumer (sequence == pos + 1). Producers claim positions with one CAS on the
+ * tail; the consumer never contends with them.
+ */
+template <typename T> class MpscQueue {
+  public:
+    explicit MpscQueue(size_t capacity)
+        : size_(std::bit_ceil(std::max<size_t>(capacity, 2))), cells_(new Cell[size_]) {
+        for (size_t i = 0; i < size_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue &)            = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    /**
+     * Enqueue a copy of `value`. Safe from any thread.
+     * @return false if the queue is full.
+     */
+    bool try_push(const T &value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell    = cells_[pos & (size_ - 1)];
+            size_t seq    = cell.sequence.load(std::memory_order_acquire);
+            auto distance = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (distance == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (distance < 0) {
+                return false; // Cell still holds a value from one lap ago
+            } else {
+                pos = tail_.load(std::memory_order_relaxed); // Another producer took it
+            }
+        }
+    }
+
+    /**
+     * Dequeue the oldest element into `out`. Consumer thread only.
+     * @return false if the queue is empty (or the next producer has not finished).
+     */
+    bool try_pop(T &out) {
+        Cell &cell = cells_[head_ & (size_ - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != head_ + 1) {
+            return false;
+        }
+        out = cell.value;
+        cell.sequence.store(head_ + size_, std::memory_order_release); // Free for the next lap
+        ++head_;
+        return true;
+    }
+
+    size_t capacity() const {
+        return size_;
+    }
+
+  private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    size_t size_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<size_t> tail_{0}; // Next position to claim (producers)
+    alignas(64) size_t head_ = 0;             // Next position to pop (consumer)
+};
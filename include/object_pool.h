@@ -1,61 +1,170 @@
 #pragma once
 
+#include <bit>
 #include <cassert>
 #include <cstddef> // for size_t
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <vector>
 
 
+/**
+ * Pool of fixed-size objects carved out of slabs that are never moved or freed,
+ * so pointers into the pool stay valid as it grows.
+ *
+ * Every slot has a stable dense index (slab * slab_size + offset) that callers can
+ * use to key parallel arrays. Free slots hold the index of the next free slot in
+ * their own storage, so allocate and deallocate touch only the slot itself.
+ */
 template <typename T> class ObjectPool {
   public:
-    // Constructor to initialize the pool with a specified size
-    explicit ObjectPool(size_t pool_size) {
-        pool_.reserve(pool_size);
-        for (size_t i = 0; i < pool_size; ++i) {
-            pool_.emplace_back();
-            free_indices_.push_back(i);
+    static constexpr size_t kDefaultSlabSize = 4096;
+
+    /**
+     * @param initial_capacity Slots available up front (rounded up to whole slabs).
+     * @param max_capacity Limit on live objects; 0 means unbounded.
+     * @param prefault Touch every page of each new slab when it is created, so the
+     *        first use of a slot never takes a page fault.
+     * @param slab_size Slots per slab (rounded up to a power of two).
+     */
+    explicit ObjectPool(size_t initial_capacity, size_t max_capacity = 0, bool prefault = false,
+                        size_t slab_size = kDefaultSlabSize)
+        : slab_size_(std::bit_ceil(slab_size ? slab_size : 1)),
+          slab_shift_(static_cast<unsigned>(std::countr_zero(slab_size_))),
+          max_capacity_(max_capacity), prefault_(prefault) {
+        while (capacity() < initial_capacity && grow()) {
+        }
+    }
+
+    ObjectPool(const ObjectPool &)            = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            // Only slots handed out and not returned hold live objects; slots beyond
+            // the bump mark were never constructed
+            std::vector<bool> free(capacity(), false);
+            for (uint32_t i = free_head_; i != kNone; i = next_free(i)) {
+                free[i] = true;
+            }
+            for (uint32_t i = 0; i < bump_; ++i) {
+                if (!free[i]) {
+                    at(i).~T();
+                }
+            }
         }
     }
 
     /**
-     * Allocate an object from the pool.
-     * @return Pointer to allocated object, or nullptr if pool is exhausted.
+     * Allocate an object from the pool, growing by one slab if it is full.
+     * @param index Receives the slot's stable index.
+     * @return Pointer to a default-constructed object, or nullptr if the pool is at
+     *         its growth limit.
      */
-    T *allocate() {
-        if (free_indices_.empty()) {
+    T *allocate(uint32_t &index) {
+        if (max_capacity_ != 0 && in_use_ >= max_capacity_) {
             return nullptr; // Pool exhausted
         }
-        size_t index = free_indices_.back();
-        free_indices_.pop_back();
-        return &pool_[index];
+        if (free_head_ != kNone) {
+            index      = free_head_;
+            free_head_ = next_free(index);
+        } else {
+            if (bump_ == capacity() && !grow()) {
+                return nullptr; // Index space exhausted
+            }
+            index = static_cast<uint32_t>(bump_++);
+        }
+        ++in_use_;
+        return ::new (slot(index)) T();
     }
 
     /**
      * Return an object to the pool.
      * @param obj Pointer to object to deallocate.
+     * @param index The index allocate() reported for it.
      */
-    void deallocate(T *obj) {
-        size_t index = obj - &pool_[0];
-        assert(index < pool_.size()); // Ensure the object belongs to the pool
-        free_indices_.push_back(index);
+    void deallocate(T *obj, uint32_t index) {
+        assert(static_cast<void *>(obj) == slot(index)); // Ensure the object belongs to the pool
+        obj->~T();
+        std::memcpy(slot(index), &free_head_, sizeof(free_head_));
+        free_head_ = index;
+        --in_use_;
+    }
+
+    // Start loading the slot the next allocate() will hand out
+    void prefetch_next() {
+        if (free_head_ != kNone) {
+            __builtin_prefetch(slot(free_head_), 1);
+        } else if (bump_ < capacity()) {
+            __builtin_prefetch(slot(bump_), 1);
+        }
+    }
+
+    // Object at a slot index previously returned by allocate()
+    T &at(uint32_t index) {
+        return *std::launder(reinterpret_cast<T *>(slot(index)));
     }
 
     /**
-     * Get the number of available slots in the pool.
-     * @return Number of free objects.
+     * Get the number of slots that can be allocated without growing.
+     * @return Number of free objects in the slabs allocated so far.
      */
     size_t available() const {
-        return free_indices_.size();
+        return capacity() - in_use_;
     }
 
     /**
-     * Get the total capacity of the pool.
-     * @return Total pool capacity.
+     * Get the current capacity of the pool.
+     * @return Slots in all slabs allocated so far.
      */
     size_t capacity() const {
-        return pool_.size();
+        return slabs_.size() * slab_size_;
+    }
+
+    // Limit on live objects (0 = unbounded)
+    size_t max_capacity() const {
+        return max_capacity_;
     }
 
   private:
-    std::vector<T> pool_;              // Pre-allocated objects
-    std::vector<size_t> free_indices_; // Stack of free indices
+    struct alignas(T) Slot {
+        std::byte bytes[sizeof(T)];
+    };
+    static_assert(sizeof(T) >= sizeof(uint32_t), "free list link must fit in a slot");
+
+    static constexpr uint32_t kNone = static_cast<uint32_t>(-1);
+
+    void *slot(size_t index) {
+        return &slabs_[index >> slab_shift_][index & (slab_size_ - 1)];
+    }
+
+    uint32_t next_free(uint32_t index) {
+        uint32_t next;
+        std::memcpy(&next, slot(index), sizeof(next));
+        return next;
+    }
+
+    // Add one slab; false once the 32-bit index space is used up
+    bool grow() {
+        if (capacity() + slab_size_ > kNone) {
+            return false;
+        }
+        slabs_.emplace_back(new Slot[slab_size_]); // Left uninitialised; pages fault on first use
+        if (prefault_) {
+            std::memset(slabs_.back().get(), 0, slab_size_ * sizeof(Slot));
+        }
+        return true;
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> slabs_; // Fixed-size blocks, never moved
+    size_t slab_size_;
+    unsigned slab_shift_;
+    size_t max_capacity_;
+    bool prefault_;
+    uint32_t free_head_ = kNone; // Most recently freed slot
+    size_t bump_        = 0;     // Slots at or past this index were never handed out
+    size_t in_use_      = 0;
 };
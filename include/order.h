@@ -41,7 +41,7 @@ inline std::string to_string(const OrderStatus status) {
 }
 
 inline std::ostream &operator<<(std::ostream &os, const Order &order) {
-    os << "Order{ID:" << order.id << ", Symbol:" << order.symbol
+    os << "Order{ID:" << order.id << ", SymbolId:" << order.symbol
        << ", Side:" << to_string(order.side) << ", Type:" << to_string(order.type)
        << ", Price:" << order.price << ", Quantity:" << order.quantity
        << ", Filled:" << order.quantity_filled << ", Status:" << to_string(order.status)
@@ -1,34 +1,193 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
-#include <list>
-#include <map>
+#include <flat_hash_map.h>
 #include <memory>
+#include <price_ladder.h>
+#include <seqlock.h>
 #include <types.h>
-#include <unordered_map>
 #include <vector>
 
 class OrderBook {
     friend class MatchingEngine; // Allow MatchingEngine to access private members
 
   public:
+    // Default number of ticks held in each side's price ladder window
+    static constexpr size_t kDefaultWindowTicks = 16384;
+    // Default number of resting orders the order index is sized for up front
+    static constexpr size_t kDefaultIndexCapacity = 16384;
+
+    // CONTINUOUS matches orders as they arrive; AUCTION only collects them (the book may
+    // cross) until the uncross
+    enum class Phase : uint8_t { CONTINUOUS, AUCTION };
+
+    // Single-price cross of a (possibly crossed) book; volume 0 if nothing crosses
+    struct Uncross {
+        Price price     = 0;
+        Quantity volume = 0;
+    };
+
     // Constructor
-    explicit OrderBook(const std::string &symbol);
+    explicit OrderBook(const std::string &symbol, size_t window_ticks = kDefaultWindowTicks,
+                       size_t index_capacity = kDefaultIndexCapacity);
 
     // Core methods
-    void add_order(Order *order);
-    Order *cancel_order(const OrderID &order_id);
-    Order *getOrderbyId(const OrderID &order_id);
+    void add_order(RestingOrder *order);
+    RestingOrder *cancel_order(const OrderID &order_id);
+    RestingOrder *getOrderbyId(const OrderID &order_id);
+
+    // Apply an execution of `qty` to a resting order, removing it from the book once filled
+    void fill_order(RestingOrder *order, Quantity qty);
+
+    // Cancel/replace support. Shrink a resting order's total quantity in place; it
+    // keeps its queue position. `new_quantity` must stay above the filled quantity.
+    void reduce_order(RestingOrder *order, Quantity new_quantity);
+    // Take an order off its level so it can be repriced; it stays in the id index
+    void detach_order(RestingOrder *order);
+    // Queue a detached order at the back of the level for its current price
+    void reattach_order(RestingOrder *order);
+    // Drop the index entry of a detached order that will not come back (filled while repricing)
+    void forget_order(const OrderID &order_id);
+
+    // Same as fill_order for an order known at compile time to rest on side S
+    template <OrderSide S> void fill_order(RestingOrder *order, Quantity qty) {
+        PriceLadder<S> &side = ladder<S>();
+        side.reduce(order, qty);
+        order->reduce_quantity(qty);
+        if (order->is_filled()) {
+            side.remove(order);
+            order_lookup_.erase(order->id);
+        }
+        note_level<S>(order->price);
+    }
+
+    // The ladder holding side S
+    template <OrderSide S> PriceLadder<S> &ladder() {
+        if constexpr (S == OrderSide::BUY) {
+            return buy_orders_;
+        } else {
+            return sell_orders_;
+        }
+    }
+    template <OrderSide S> const PriceLadder<S> &ladder() const {
+        return const_cast<OrderBook *>(this)->ladder<S>();
+    }
+
+    // Warm the cache lines an incoming order will touch: the opposite touch it matches
+    // against, its own level and its index slot should it rest
+    void prefetch(OrderID order_id, OrderSide side, Price price) const {
+        if (side == OrderSide::BUY) {
+            sell_orders_.prefetch(sell_orders_.best());
+            buy_orders_.prefetch(price);
+        } else {
+            buy_orders_.prefetch(buy_orders_.best());
+            sell_orders_.prefetch(price);
+        }
+        order_lookup_.prefetch(order_id);
+    }
+
+    Phase phase() const {
+        return phase_;
+    }
+    void set_phase(Phase phase) {
+        phase_ = phase;
+    }
+
+    /**
+     * Equilibrium price for an auction uncross, from one pass over the level aggregates
+     * in the crossed range. It maximises executable volume, then minimises the
+     * imbalance left over. Remaining ties go to the highest price with buy surplus,
+     * the lowest with sell surplus, and the middle of the range when balanced.
+     */
+    Uncross find_uncross();
 
     // Query methods
-    Order *getBestBid(); // Returns pointer to best bid order
-    Order *getBestAsk(); // Returns pointer to best ask order
-    Price getSpread();   // Returns the spread between best ask and best bid
+    RestingOrder *getBestBid(); // Returns pointer to best bid order
+    RestingOrder *getBestAsk(); // Returns pointer to best ask order
+    Price getSpread();          // Returns the spread between best ask and best bid
 
     // Market data methods
     L1Quote getL1Quote();
     L2Quote getL2Quote(size_t depth = 10) const;
 
+    // Copy the current top BookTop::kDepth levels per side (matching thread)
+    void getBookTop(BookTop &top) const;
+
+    /**
+     * Start the level-change feed: report every current level to `fn` as an ADD, then
+     * record each change to a level's total until drained. Off by default, so books
+     * nobody watches pay nothing.
+     */
+    template <typename Fn> void start_level_updates(Fn &&fn) {
+        record_levels_ = true;
+        level_updates_.clear();
+        auto seed = [&](OrderSide side) {
+            return [&fn, side](Price price, const LevelQueue &level) {
+                fn(LevelUpdate{LevelUpdate::Action::ADD, side, price, level.total_qty});
+                return true;
+            };
+        };
+        buy_orders_.for_each_level(seed(OrderSide::BUY));
+        sell_orders_.for_each_level(seed(OrderSide::SELL));
+    }
+
+    bool records_level_updates() const {
+        return record_levels_;
+    }
+
+    /**
+     * Hand the changes recorded since the last drain to `fn`, merged to one update per
+     * level: ADD if the level is new, DELETE if it emptied, CHANGE with the new total
+     * otherwise. A level that came and went in between is not reported.
+     */
+    template <typename Fn> void drain_level_updates(Fn &&fn) {
+        auto same_level = [](const LevelUpdate &a, const LevelUpdate &b) {
+            return a.side == b.side && a.price == b.price;
+        };
+        if (level_updates_.size() > 1) {
+            // Group by level; stable, so each level's changes stay oldest first
+            std::stable_sort(level_updates_.begin(), level_updates_.end(),
+                             [](const LevelUpdate &a, const LevelUpdate &b) {
+                                 return a.side != b.side ? a.side < b.side : a.price < b.price;
+                             });
+        }
+        for (size_t i = 0; i < level_updates_.size();) {
+            size_t last = i;
+            while (last + 1 < level_updates_.size() &&
+                   same_level(level_updates_[last + 1], level_updates_[i])) {
+                ++last;
+            }
+            // The first change tells whether the level existed before, the last where it is now
+            bool existed       = level_updates_[i].action != LevelUpdate::Action::ADD;
+            LevelUpdate update = level_updates_[last];
+            if (existed || update.action != LevelUpdate::Action::DELETE) {
+                if (!existed) {
+                    update.action = LevelUpdate::Action::ADD;
+                } else if (update.action == LevelUpdate::Action::ADD) {
+                    update.action = LevelUpdate::Action::CHANGE;
+                }
+                fn(update);
+            }
+            i = last + 1;
+        }
+        level_updates_.clear();
+    }
+
+    /**
+     * Market-data snapshot: publish() stores the current top of book after a change
+     * (matching thread); snapshot() returns the last one published and may be called
+     * from any thread, lock-free and without stalling the matcher.
+     */
+    void publish() {
+        BookTop top;
+        getBookTop(top);
+        published_.store(top);
+    }
+    BookTop snapshot() const {
+        return published_.load();
+    }
+
     // Statistics
     size_t getTotalOrders() const;
     size_t getBuyOrders() const;
@@ -40,17 +199,47 @@ class OrderBook {
 
   private:
     Symbol symbol_;
+    Phase phase_ = Phase::CONTINUOUS;
+    SeqLock<BookTop> published_;
 
     // Order book structures
-    // Buy Orders: Price -> List of Orders (sorted descending)
-    std::map<Price, std::list<Order *>> buy_orders_;
+    // Buy Orders: tick-indexed ladder of FIFO levels (best = highest)
+    PriceLadder<OrderSide::BUY> buy_orders_;
+
+    // Sell Orders: tick-indexed ladder of FIFO levels (best = lowest)
+    PriceLadder<OrderSide::SELL> sell_orders_;
+
+    // Order ID to resting order mapping for quick access (open addressing, no node allocation)
+    FlatHashMap<OrderID, RestingOrder *> order_lookup_;
 
-    // Sell Orders: Price -> List of Orders (sorted ascending)
-    std::map<Price, std::list<Order *>> sell_orders_;
+    // Level-change feed (start_level_updates)
+    bool record_levels_ = false;
+    std::vector<LevelUpdate> level_updates_;
 
-    // Order ID to OrderInfo mapping for quick access
-    std::unordered_map<OrderID, OrderInfo> order_lookup_;
+    // Scratch for find_uncross: the crossed range's bid and ask aggregates
+    std::vector<std::pair<Price, Quantity>> uncross_bids_;
+    std::vector<std::pair<Price, Quantity>> uncross_asks_;
+
+    // Record the state of the level at `price` after a change; `added` when an order
+    // was just queued there
+    template <OrderSide S> void note_level(Price price, bool added = false) {
+        if (!record_levels_) {
+            return;
+        }
+        const LevelQueue *level = ladder<S>().find(price);
+        LevelUpdate::Action action = !level                       ? LevelUpdate::Action::DELETE
+                                     : added && level->count == 1 ? LevelUpdate::Action::ADD
+                                                                  : LevelUpdate::Action::CHANGE;
+        level_updates_.push_back({action, S, price, level ? level->total_qty : 0});
+    }
+    void note_level(const RestingOrder *order, bool added = false) {
+        if (order->side == OrderSide::BUY) {
+            note_level<OrderSide::BUY>(order->price, added);
+        } else {
+            note_level<OrderSide::SELL>(order->price, added);
+        }
+    }
 
     // Helper methods
-    Order *getBestOrder(OrderSide side);
+    RestingOrder *getBestOrder(OrderSide side);
 };
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * Per-connection output queues for the epoll loop.
+ *
+ * Packets are copied into fixed-size blocks and each connection's queue leaves as one
+ * gathered write (sendmsg over the blocks) per flush, however many packets it holds.
+ * A short write keeps the unsent rest in order. A connection whose socket is full is
+ * parked until writable() instead of being retried every iteration. Drained blocks go
+ * to a free list, so steady-state sending does not allocate.
+ */
+class OutboundBuffers {
+  public:
+    static constexpr size_t kBlockSize = 16384;
+    static constexpr int kMaxIov       = 64; // Blocks gathered per sendmsg
+
+    /**
+     * Queue a packet for `fd`; it leaves with the next flush().
+     * @return Bytes now queued for the connection.
+     */
+    size_t append(int fd, const char *data, size_t len);
+
+    // Write out every connection with queued output and room in its socket
+    void flush();
+
+    // The socket has room again (EPOLLOUT); it is written with the next flush()
+    void writable(int fd);
+
+    // Drop whatever is queued for a closed connection
+    void reset(int fd);
+
+    // Also store each connection's queued() in counts[fd] whenever it changes, so other
+    // threads can read it; fds at or past `size` are not mirrored
+    void mirrorQueued(std::atomic<size_t> *counts, size_t size) {
+        mirror_      = counts;
+        mirror_size_ = size;
+    }
+
+    // Bytes queued for `fd` and not yet written
+    size_t queued(int fd) const {
+        return fd >= 0 && static_cast<size_t>(fd) < connections_.size() ? connections_[fd].queued
+                                                                        : 0;
+    }
+
+  private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t head = 0; // First unsent byte
+        size_t tail = 0; // End of queued bytes
+    };
+
+    struct Connection {
+        std::vector<Block> blocks;
+        size_t queued = 0;     // Unsent bytes across blocks
+        bool listed   = false; // In dirty_
+        bool blocked  = false; // Socket full: wait for writable()
+    };
+
+    void flushConnection(int fd, Connection &conn);
+    void consume(Connection &conn, size_t len);
+    void release(Block &block);
+    void publish(int fd, const Connection &conn);
+
+    std::vector<Connection> connections_; // Indexed by fd
+    std::vector<int> dirty_;              // Connections with output to write
+    std::vector<std::unique_ptr<char[]>> free_blocks_;
+    std::atomic<size_t> *mirror_ = nullptr;
+    size_t mirror_size_          = 0;
+};
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <level_bitmap.h>
+#include <map>
+#include <type_traits>
+#include <types.h>
+#include <vector>
+
+/**
+ * FIFO of the orders resting at one price, threaded through the orders' own
+ * prev/next links. The level caches its open quantity and order count so depth
+ * queries never walk the orders, and queuing an order allocates nothing.
+ */
+struct LevelQueue {
+    RestingOrder *head = nullptr;
+    RestingOrder *tail = nullptr;
+    Quantity total_qty = 0; // Sum of remaining_qty() over the queue
+    uint32_t count     = 0; // Number of orders in the queue
+
+    bool empty() const {
+        return head == nullptr;
+    }
+
+    RestingOrder *front() const {
+        return head;
+    }
+
+    void push_back(RestingOrder *order) {
+        order->prev = tail;
+        order->next = nullptr;
+        if (tail) {
+            tail->next = order;
+        } else {
+            head = order;
+        }
+        tail = order;
+        total_qty += order->remaining_qty();
+        ++count;
+    }
+
+    void remove(RestingOrder *order) {
+        (order->prev ? order->prev->next : head) = order->next;
+        (order->next ? order->next->prev : tail) = order->prev;
+        order->prev = order->next = nullptr;
+        total_qty -= order->remaining_qty();
+        --count;
+    }
+};
+
+/**
+ * One side of an order book, stored as a contiguous array of price levels indexed
+ * by tick offset from a movable base price.
+ *
+ * Prices outside the window go to an ordered overflow map, so no order is ever
+ * rejected for being far from the touch. The window is recentred when the touch
+ * leaves it or when the in-window part of the side drains.
+ *
+ * A LevelBitmap over the window marks occupied levels, so the next best level and
+ * the L2 walk jump straight between non-empty ticks instead of scanning the array.
+ */
+template <OrderSide S> class PriceLadder {
+  public:
+    using Level = LevelQueue;
+
+    explicit PriceLadder(size_t window_ticks)
+        : levels_(window_ticks ? window_ticks : 1), occupied_(levels_.size()) {
+    }
+
+    // True if price `a` is more aggressive than price `b` on this side
+    static bool better(Price a, Price b) {
+        return S == OrderSide::BUY ? a > b : a < b;
+    }
+
+    bool empty() const {
+        return level_count_ == 0;
+    }
+
+    // Number of non-empty price levels
+    size_t levels() const {
+        return level_count_;
+    }
+
+    // Best price on this side. Only meaningful when !empty().
+    Price best() const {
+        return best_;
+    }
+
+    /**
+     * Find the level at a price.
+     * @return Pointer to the level, or nullptr if no orders rest at that price.
+     */
+    Level *find(Price price) {
+        if (in_window(price)) {
+            Level &level = levels_[index(price)];
+            return level.empty() ? nullptr : &level;
+        }
+        auto it = overflow_.find(price);
+        return it == overflow_.end() ? nullptr : &it->second;
+    }
+
+    // Start loading the level at `price` (window levels only; overflow levels are tree nodes)
+    void prefetch(Price price) const {
+        if (in_window(price)) {
+            __builtin_prefetch(&levels_[index(price)]);
+        }
+    }
+
+    RestingOrder *best_order() {
+        return find(best_)->front();
+    }
+
+    // Total number of orders resting on this side
+    size_t orders() const {
+        return order_count_;
+    }
+
+    // Remaining quantity resting on this side, over all levels
+    Quantity total_qty() const {
+        return total_qty_;
+    }
+
+    // Queue an order at the back of its price level
+    void push_back(RestingOrder *order) {
+        acquire(order->price).push_back(order);
+        ++order_count_;
+        total_qty_ += order->remaining_qty();
+    }
+
+    // Unlink a resting order from its price level, dropping the level if it empties
+    void remove(RestingOrder *order) {
+        Level *level = find(order->price);
+        if (!level) {
+            return;
+        }
+        level->remove(order);
+        --order_count_;
+        total_qty_ -= order->remaining_qty();
+        release(order->price);
+    }
+
+    // Account for `qty` of a resting order having executed
+    void reduce(RestingOrder *order, Quantity qty) {
+        find(order->price)->total_qty -= qty;
+        total_qty_ -= qty;
+    }
+
+    /**
+     * Visit non-empty levels from best to worst.
+     * @param fn Callable (Price, const Level&) returning false to stop the walk.
+     */
+    template <typename Fn> void for_each_level(Fn &&fn) const {
+        if (level_count_ == 0) {
+            return;
+        }
+        size_t i = next_occupied(in_window(best_) ? index(best_) : best_end());
+        auto ov  = overflow_.begin();
+
+        while (true) {
+            bool have_array    = i != LevelBitmap::npos;
+            bool have_overflow = ov != overflow_.end();
+            if (!have_array && !have_overflow) {
+                return;
+            }
+            if (have_overflow && (!have_array || better(ov->first, slot_price(i)))) {
+                if (!fn(ov->first, ov->second)) {
+                    return;
+                }
+                ++ov;
+            } else {
+                if (!fn(slot_price(i), levels_[i])) {
+                    return;
+                }
+                i = next_occupied(step_worse(i));
+            }
+        }
+    }
+
+  private:
+    // Get the level an order at `price` should be queued on, creating it if needed.
+    // The caller must append an order to the returned level.
+    Level &acquire(Price price) {
+        if (!in_window(price) &&
+            (in_window_count_ == 0 || (level_count_ > 0 && better(price, best_)))) {
+            recenter(price); // The touch has left the window
+        }
+
+        Level *level   = nullptr;
+        bool was_empty = false;
+        if (in_window(price)) {
+            level     = &levels_[index(price)];
+            was_empty = level->empty();
+            if (was_empty) {
+                occupied_.set(index(price));
+                ++in_window_count_;
+            }
+        } else {
+            auto [it, inserted] = overflow_.try_emplace(price);
+            level               = &it->second;
+            was_empty           = inserted;
+        }
+
+        if (was_empty) {
+            if (level_count_ == 0 || better(price, best_)) {
+                best_ = price;
+            }
+            ++level_count_;
+        }
+        return *level;
+    }
+
+    // Update bookkeeping after an order was removed from the level at `price`.
+    // Drops the level if it is now empty and moves the best price if needed.
+    void release(Price price) {
+        if (in_window(price)) {
+            if (!levels_[index(price)].empty()) {
+                return;
+            }
+            occupied_.clear(index(price));
+            --in_window_count_;
+        } else {
+            auto it = overflow_.find(price);
+            if (it == overflow_.end() || !it->second.empty()) {
+                return;
+            }
+            overflow_.erase(it);
+        }
+        --level_count_;
+
+        if (level_count_ == 0) {
+            return;
+        }
+        if (price == best_) {
+            best_ = next_best(price);
+        }
+        if (in_window_count_ == 0) {
+            recenter(best_);
+        }
+    }
+
+    // Overflow levels are ordered best-first, like the window walk
+    using Compare = std::conditional_t<S == OrderSide::BUY, std::greater<Price>, std::less<Price>>;
+
+    std::vector<Level> levels_;                // Window of levels, index 0 == base_
+    LevelBitmap occupied_;                     // Occupancy of the window slots
+    std::map<Price, Level, Compare> overflow_; // Levels outside the window
+    Price base_             = 0;               // Price of levels_[0]
+    Price best_             = 0;               // Best non-empty price (window or overflow)
+    size_t level_count_     = 0;               // Non-empty levels in total
+    size_t in_window_count_ = 0;               // Non-empty levels inside the window
+    size_t order_count_     = 0;               // Orders resting on this side
+    Quantity total_qty_     = 0;               // Sum of the levels' total_qty
+
+    bool in_window(Price price) const {
+        return price >= base_ && price < base_ + static_cast<Price>(levels_.size());
+    }
+
+    size_t index(Price price) const {
+        return static_cast<size_t>(price - base_);
+    }
+
+    Price slot_price(size_t i) const {
+        return base_ + static_cast<Price>(i);
+    }
+
+    // Index of the most aggressive slot in the window
+    size_t best_end() const {
+        return S == OrderSide::BUY ? levels_.size() - 1 : 0;
+    }
+
+    // One slot towards less aggressive prices (npos when walking off the window)
+    static size_t step_worse(size_t i) {
+        if (S == OrderSide::BUY) {
+            return i == 0 ? LevelBitmap::npos : i - 1;
+        }
+        return i + 1;
+    }
+
+    // First occupied slot at `i` or less aggressive, or npos
+    size_t next_occupied(size_t i) const {
+        return S == OrderSide::BUY ? occupied_.find_prev(i) : occupied_.find_next(i);
+    }
+
+    // Find the new best once the level at `from` (the old best) has emptied
+    Price next_best(Price from) const {
+        bool found = false;
+        Price best = 0;
+        size_t i   = next_occupied(in_window(from) ? index(from) : best_end());
+        if (i != LevelBitmap::npos) {
+            best  = slot_price(i);
+            found = true;
+        }
+        if (!overflow_.empty() && (!found || better(overflow_.begin()->first, best))) {
+            best = overflow_.begin()->first;
+        }
+        return best;
+    }
+
+    // Move the window so that it is centred on `center`, migrating levels both ways
+    void recenter(Price center) {
+        size_t i = occupied_.find_next(0);
+        while (i != LevelBitmap::npos) {
+            overflow_[slot_price(i)] = levels_[i];
+            levels_[i]               = Level{};
+            i = occupied_.find_next(i + 1);
+        }
+        occupied_.reset();
+        in_window_count_ = 0;
+
+        base_ = center - static_cast<Price>(levels_.size() / 2);
+
+        for (auto it = overflow_.begin(); it != overflow_.end();) {
+            if (in_window(it->first)) {
+                levels_[index(it->first)] = it->second;
+                occupied_.set(index(it->first));
+                ++in_window_count_;
+                it = overflow_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
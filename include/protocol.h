@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 
 #pragma pack(push, 1)
@@ -10,8 +11,12 @@ enum class MessageType : uint8_t {
     NEW_ORDER            = 'N',
     EXECUTION_REPORT     = 'E',
     ORDER_CANCEL         = 'C',
+    ORDER_REPLACE        = 'G',
+    ORDER_MASS_CANCEL    = 'K',
+    TRADING_PHASE        = 'P',
     MARKET_DATA_REQUEST  = 'M',
     MARKET_DATA_SNAPSHOT = 'S',
+    MARKET_DATA_UPDATE   = 'U',
     SUBSCRIPTION_REQUEST = 'Q',
     TRADE_UPDATE         = 'T',
     CLIENT_DISCONNECT    = 'X'
@@ -29,6 +34,9 @@ struct LoginRequest {
     MessageHeader header;
     char username[20];
     char password[20];
+    // Optional (older clients omit it; msg_len tells): 1 = cancel the resting orders
+    // sent on this session when it disconnects
+    uint8_t cancel_on_disconnect;
 };
 
 struct NewOrderRequest {
@@ -68,6 +76,31 @@ struct MarketDataSnapshot {
     L2Entry asks[5]; // Top 5 asks
 };
 
+struct L2Delta {
+    double price;
+    uint64_t quantity; // Total at the level afterwards; 0 on Delete
+    uint8_t side;      // 0=Buy, 1=Sell
+    uint8_t action;    // 0=Add, 1=Change, 2=Delete
+};
+
+// SERVER -> SUBSCRIBER: incremental L2 feed, every price level of the book. Each delta
+// message takes the symbol's next sequence number. A snapshot (sent on subscribe, on a
+// repeated subscribe after a gap, or when a slow subscriber is resynced) is one or more
+// messages of Adds carrying the number of the last delta they include; clear the book
+// on kSnapshotBegin and resume deltas after kSnapshotEnd.
+struct MarketDataUpdate {
+    static constexpr uint8_t kSnapshotBegin = 1;
+    static constexpr uint8_t kSnapshotEnd   = 2;
+    static constexpr size_t kMaxLevels      = 48;
+
+    MessageHeader header; // msg_len covers only the num_levels entries sent
+    char symbol[10];
+    uint64_t seq_num;
+    uint8_t flags; // 0 on deltas
+    uint8_t num_levels;
+    L2Delta levels[kMaxLevels];
+};
+
 struct ExecutionReport {
     MessageHeader header;
     uint64_t client_order_id;
@@ -78,13 +111,13 @@ struct ExecutionReport {
     double price;
     uint64_t quantity;
     uint64_t filled_quantity;
-    uint8_t status; // 0=New, 1=Partially Filled, 2=Filled, 3=Canceled, 4=Rejected
+    uint8_t status; // 0=New, 1=Partially Filled, 2=Filled, 3=Canceled, 4=Rejected, 5=Replaced
 };
 
 struct SubscriptionRequest {
     MessageHeader header;
     char symbol[10];
-    uint8_t is_subscribe; // 0=Unsubscribe, 1=Subscribe
+    uint8_t is_subscribe; // 0=Unsubscribe, 1=Subscribe (again for a fresh snapshot)
 };
 
 struct TradeUpdate {
@@ -104,4 +137,35 @@ struct OrderCancelRequest {
     uint8_t side; // 0=Buy, 1=Sell
 };
 
+// CLIENT -> SERVER: change the price and/or total quantity of a resting order.
+// A smaller quantity at the same price keeps the order's queue position.
+struct OrderReplaceRequest {
+    MessageHeader header;
+    uint64_t client_order_id;
+    uint64_t user_id;
+    char symbol[10];
+    uint8_t side;          // 0=Buy, 1=Sell
+    double new_price;
+    uint64_t new_quantity; // Total quantity including anything already filled
+};
+
+// CLIENT -> SERVER: cancel many resting orders at once. Each cancelled order gets its
+// own Canceled execution report. Scope 2 is an admin operation, ignored unless the
+// server runs with --allow-symbol-mass-cancel.
+struct OrderMassCancelRequest {
+    MessageHeader header;
+    uint64_t user_id;
+    char symbol[10]; // Ignored for scope 0
+    uint8_t scope;   // 0=user's orders, 1=user's orders in symbol, 2=every order in symbol
+};
+
+// CLIENT -> SERVER: switch a symbol between continuous trading and a call auction.
+// Leaving the auction uncrosses the book at one price; the fills go out as trade updates.
+// An admin operation, ignored unless the server runs with --allow-trading-phase.
+struct TradingPhaseRequest {
+    MessageHeader header;
+    char symbol[10];
+    uint8_t phase; // 0=Continuous (uncross), 1=Auction
+};
+
 #pragma pack(pop)
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+/**
+ * Fixed-size receive buffer for one client session.
+ *
+ * The socket reads straight into the free space at the back and frames are decoded in
+ * place from the front. Only the bytes of an incomplete frame are ever moved, back to
+ * the start once the free space runs low, so parsing is linear in the bytes received
+ * and nothing is allocated after the first read.
+ */
+class RecvBuffer {
+  public:
+    static constexpr size_t kCapacity = 16384;
+    static constexpr size_t kMaxFrame = 1024; // Largest message the protocol allows
+
+    /**
+     * Free space to read into, compacting first if less than a frame is left.
+     * @return Pointer and size; commit() what was written.
+     */
+    std::pair<char *, size_t> reserve() {
+        if (!data_) {
+            // kMaxFrame of slack past the end keeps reads of a short (older client) frame
+            // as its full struct inside the allocation
+            data_.reset(new char[kCapacity + kMaxFrame]());
+        } else if (kCapacity - tail_ < kMaxFrame) {
+            compact();
+        }
+        return {data_.get() + tail_, kCapacity - tail_};
+    }
+
+    // Where the next reserve() points, to tell an in-place read from a foreign one
+    const char *write_ptr() const {
+        return data_.get() + tail_;
+    }
+
+    void commit(size_t len) {
+        tail_ += len;
+    }
+
+    /**
+     * Copy in bytes received elsewhere (e.g. an io_uring provided buffer).
+     * @return Bytes taken; the caller decodes frames and offers the rest again.
+     */
+    size_t append(const char *data, size_t len) {
+        auto [ptr, space] = reserve();
+        size_t taken      = std::min(len, space);
+        std::memcpy(ptr, data, taken);
+        tail_ += taken;
+        return taken;
+    }
+
+    const char *read_ptr() const {
+        return data_.get() + head_;
+    }
+
+    size_t readable() const {
+        return tail_ - head_;
+    }
+
+    void consume(size_t len) {
+        head_ += len;
+        if (head_ == tail_) {
+            head_ = tail_ = 0; // Drained: start over without moving anything
+        }
+    }
+
+    void clear() {
+        head_ = tail_ = 0;
+    }
+
+  private:
+    void compact() {
+        std::memmove(data_.get(), data_.get() + head_, tail_ - head_);
+        tail_ -= head_;
+        head_ = 0;
+    }
+
+    std::unique_ptr<char[]> data_;
+    size_t head_ = 0; // First unread byte
+    size_t tail_ = 0; // End of received data
+};
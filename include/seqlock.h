@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Single-writer sequence lock around a small trivially copyable value.
+ *
+ * The writer bumps the sequence to odd, stores the value and bumps it back to even;
+ * a reader copies the value and retries if the sequence was odd or moved meanwhile.
+ * Neither side ever blocks the other, and any number of threads may read. The value
+ * is kept as relaxed atomic words so a read racing a write is a retry, not a data race.
+ */
+template <typename T> class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock values are copied word by word");
+
+  public:
+    SeqLock() {
+        store(T{});
+    }
+
+    SeqLock(const SeqLock &)            = delete;
+    SeqLock &operator=(const SeqLock &) = delete;
+
+    // Publish a new value. One writer thread only.
+    void store(const T &value) {
+        std::array<uint64_t, kWords> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+        uint64_t seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+
+    // Copy out the latest complete value. Safe from any thread.
+    T load() const {
+        std::array<uint64_t, kWords> words;
+        while (true) {
+            uint64_t before = sequence_.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue; // Write in progress
+            }
+            for (size_t i = 0; i < kWords; ++i) {
+                words[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+        // Through bytes and bit_cast: T may have default member initializers, so it
+        // is trivially copyable without being trivial, and memcpy into it would warn
+        std::array<std::byte, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), words.data(), sizeof(T));
+        return std::bit_cast<T>(bytes);
+    }
+
+  private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint64_t> sequence_{0};
+    std::atomic<uint64_t> words_[kWords];
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <matching_engine.h>
+#include <memory>
+#include <mpsc_queue.h>
+#include <spsc_queue.h>
+#include <string>
+#include <symbol_table.h>
+#include <thread>
+#include <types.h>
+#include <vector>
+
+/**
+ * Runs matching on N threads, each owning a private MatchingEngine (books, order
+ * pool, trade history) for the symbols assigned to it.
+ *
+ * Commands reach a shard through its lock-free MPSC inbox, so any thread may submit
+ * (the network thread, replay, admin tasks), and results leave through its SPSC
+ * outbox to the one thread that polls them: the network thread, or the gateway's
+ * egress thread in pipeline mode. A symbol always maps to the same shard and each
+ * inbox is FIFO, so per-symbol price-time priority is exactly that of the
+ * single-threaded engine. Symbol ids are the gateway's; shards bind them on first
+ * sight from the wire symbol carried in every command.
+ */
+class ShardedEngine {
+  public:
+    struct Command {
+        // LEVELS starts order.symbol's level feed (OrderBook::start_level_updates)
+        enum class Kind : uint8_t { NEW_ORDER, CANCEL, REPLACE, MASS_CANCEL, PHASE, LEVELS };
+        Kind kind;
+        bool quiet     = false; // Replayed order; the gateway sends no reports
+        bool all_users = false; // MASS_CANCEL: all owners' orders in order.symbol
+        bool auction   = false; // PHASE: start order.symbol's auction, else uncross it
+        int fd         = -1;    // Client connection the result belongs to
+        uint32_t generation = 0; // TcpServer::generation(fd) at submit, copied to the results
+        Order order{};          // NEW_ORDER: the order. CANCEL: id, user, side, symbol.
+                                // REPLACE: as CANCEL plus the new price and quantity.
+                                // MASS_CANCEL: user, symbol (kInvalidSymbol = all) and
+                                // session (0 = any).
+        char symbol[SymbolTable::kMaxLength] = {}; // Wire symbol for order.symbol
+    };
+
+    struct Event {
+        enum class Kind : uint8_t {
+            TRADE,            // One fill of the command being processed; more may follow
+            ORDER_DONE,       // A NEW_ORDER is finished; order is the taker as submitted, its
+                              // fills came as TRADE events
+            CANCEL_DONE,      // A CANCEL is finished; order holds the cancelled order if found
+            REPLACE_DONE,     // A REPLACE is finished; order holds the replaced order if found
+            CANCELLED,        // One order cancelled by a MASS_CANCEL; more may follow
+            MASS_CANCEL_DONE, // A MASS_CANCEL is finished
+            PHASE_DONE,       // A PHASE is finished; the uncross fills came as TRADE events
+            LEVEL,            // One level change of order.symbol's book; more may follow
+            LEVELS_DONE       // A LEVELS is finished; the book's current levels came as LEVEL
+                              // events, and changes follow after each later command
+        };
+        Kind kind;
+        bool found    = false; // ORDER_DONE: order rests. CANCEL_DONE, REPLACE_DONE: found.
+        OrderOutcome outcome = OrderOutcome::ACCEPTED; // ORDER_DONE: what became of the order
+        bool quiet    = false;
+        int fd        = -1;
+        uint32_t generation = 0; // The command's; results for a closed connection are dropped
+        int64_t latency_ns = 0; // Time spent matching the command
+        Trade trade;
+        Order order;
+        LevelUpdate level; // LEVEL: the change
+    };
+
+    /**
+     * Start `shards` matching threads.
+     * @param queue_depth Capacity of each inbox and outbox.
+     * @param trade_spill_path Shard N spills its old trades to <path>.shard<N> (empty = dropped).
+     */
+    ShardedEngine(size_t shards, size_t queue_depth, const std::string &trade_spill_path = {});
+    ~ShardedEngine();
+
+    ShardedEngine(const ShardedEngine &)            = delete;
+    ShardedEngine &operator=(const ShardedEngine &) = delete;
+
+    size_t shards() const {
+        return shards_.size();
+    }
+
+    size_t shard_of(SymbolId symbol) const {
+        return symbol % shards_.size();
+    }
+
+    /**
+     * Queue a command on its symbol's shard. Safe from any thread; commands from
+     * one thread for one symbol are processed in submission order.
+     * @return false if the shard's inbox is full; retry once results are drained.
+     */
+    bool try_submit(const Command &command);
+
+    // Queue a command on a given shard, e.g. a per-user MASS_CANCEL sent to every shard
+    bool try_submit_to(size_t shard, const Command &command);
+
+    /**
+     * Drain results from every shard, oldest first per shard. One polling thread only.
+     * @param on_event Callable (size_t shard, const Event&). A command's TRADE,
+     *        CANCELLED and LEVEL events always precede its final event on the same shard.
+     * @return Number of events delivered.
+     */
+    template <typename Fn> size_t poll(Fn &&on_event) {
+        size_t delivered = 0;
+        Event event;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            while (shards_[i]->outbox.try_pop(event)) {
+                if (event.kind != Event::Kind::TRADE && event.kind != Event::Kind::CANCELLED &&
+                    event.kind != Event::Kind::LEVEL) {
+                    pending_.fetch_sub(1, std::memory_order_relaxed);
+                }
+                on_event(i, event);
+                ++delivered;
+            }
+        }
+        return delivered;
+    }
+
+    // Latest published top of book of a symbol, read from its shard without queueing
+    // anything or locking. Safe from any thread.
+    bool read_snapshot(SymbolId symbol, BookTop &top) const {
+        return shards_[shard_of(symbol)]->engine.read_snapshot(symbol, top);
+    }
+
+    // Commands submitted whose final event has not been polled yet
+    size_t pending() const {
+        return pending_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct Shard {
+        Shard(size_t queue_depth, const std::string &trade_spill_path)
+            : engine(trade_spill_path), inbox(queue_depth), outbox(queue_depth) {
+        }
+        MatchingEngine engine;
+        MpscQueue<Command> inbox;
+        SpscQueue<Event> outbox;
+        std::thread thread;
+    };
+
+    void run(Shard &shard);
+    void execute(Shard &shard, const Command &command);
+    void emit(Shard &shard, const Event &event);
+    void emit_levels(Shard &shard, SymbolId symbol);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<bool> running_{true};
+    std::atomic<size_t> pending_{0};
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ *
+ * Head and tail live on separate cache lines, and each side keeps a cached copy of
+ * the other side's index, so in steady state a push or pop touches shared state
+ * only when the cached index says the queue looks full or empty.
+ */
+template <typename T> class SpscQueue {
+  public:
+    explicit SpscQueue(size_t capacity)
+        : slots_(std::bit_ceil(std::max<size_t>(capacity, 2))), mask_(slots_.size() - 1) {
+    }
+
+    SpscQueue(const SpscQueue &)            = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /**
+     * Enqueue a copy of `value`. Producer thread only.
+     * @return false if the queue is full.
+     */
+    bool try_push(const T &value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == slots_.size()) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == slots_.size()) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Dequeue the oldest element into `out`. Consumer thread only.
+     * @return false if the queue is empty.
+     */
+    bool try_pop(T &out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        out = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from a thread that is neither producer nor consumer
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return slots_.size();
+    }
+
+  private:
+    alignas(64) std::atomic<size_t> head_{0}; // Next slot to pop (written by consumer)
+    size_t tail_cache_ = 0;                   // Consumer's last view of tail_
+    alignas(64) std::atomic<size_t> tail_{0}; // Next slot to push (written by producer)
+    size_t head_cache_ = 0;                   // Producer's last view of head_
+    alignas(64) std::vector<T> slots_;
+    size_t mask_;
+};
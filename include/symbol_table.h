@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <flat_hash_map.h>
+#include <instrument.h>
+#include <string_view>
+#include <types.h>
+#include <vector>
+
+/**
+ * Interns symbols into dense SymbolIds.
+ *
+ * The fixed-width wire symbol (NUL or space padded) is packed into two integers
+ * and looked up in a flat hash map, so resolving a symbol on the order path costs
+ * one hash of 16 bytes and no string allocation. Everything else about a symbol
+ * (name, padded wire form, instrument reference data) lives in arrays indexed by
+ * the id.
+ *
+ * The per-id arrays are reserved for kMaxSymbols up front and never reallocate, so
+ * a thread that received an id through a queue can read its name, wire bytes and
+ * instrument while the owning thread keeps interning new symbols.
+ */
+class SymbolTable {
+  public:
+    static constexpr size_t kMaxLength  = 16;    // Longer names are truncated
+    static constexpr size_t kMaxSymbols = 65536; // Interning fails beyond this
+
+    explicit SymbolTable(InstrumentRegistry &instruments) : registry_(instruments) {
+        names_.reserve(kMaxSymbols);
+        wire_.reserve(kMaxSymbols);
+        instruments_.reserve(kMaxSymbols);
+    }
+
+    SymbolTable(const SymbolTable &)            = delete;
+    SymbolTable &operator=(const SymbolTable &) = delete;
+
+    /**
+     * Intern a symbol given as raw (possibly padded) bytes, e.g. a protocol field.
+     * @return The symbol's id, or kInvalidSymbol if the symbol is blank or the
+     *         table is full.
+     */
+    SymbolId intern(const char *raw, size_t len) {
+        size_t n;
+        Key key = make_key(raw, len, n);
+        if (n == 0) {
+            return kInvalidSymbol;
+        }
+        if (const SymbolId *id = ids_.find(key)) {
+            return *id;
+        }
+        if (names_.size() == kMaxSymbols) {
+            return kInvalidSymbol;
+        }
+
+        auto id = static_cast<SymbolId>(names_.size());
+        ids_.insert_or_assign(key, id);
+        names_.emplace_back(raw, n);
+        std::array<char, kMaxLength> wire{};
+        std::memcpy(wire.data(), raw, n);
+        wire_.push_back(wire);
+        instruments_.push_back(&registry_.get(names_.back()));
+        return id;
+    }
+
+    SymbolId intern(std::string_view name) {
+        return intern(name.data(), name.size());
+    }
+
+    /**
+     * Register a symbol under an id assigned by another table, so that a shard's
+     * engine uses the same ids as the gateway. Ids skipped over stay unbound.
+     * @return false if the symbol is blank, the id out of range, or the symbol is
+     *         already bound to a different id.
+     */
+    bool bind(SymbolId id, const char *raw, size_t len) {
+        size_t n;
+        Key key = make_key(raw, len, n);
+        if (n == 0 || id >= kMaxSymbols) {
+            return false;
+        }
+        if (const SymbolId *existing = ids_.find(key)) {
+            return *existing == id;
+        }
+        if (id >= names_.size()) {
+            names_.resize(id + 1);
+            wire_.resize(id + 1);
+            instruments_.resize(id + 1, nullptr);
+        }
+        ids_.insert_or_assign(key, id);
+        names_[id].assign(raw, n);
+        wire_[id] = {};
+        std::memcpy(wire_[id].data(), raw, n);
+        instruments_[id] = &registry_.get(names_[id]);
+        return true;
+    }
+
+    // True if `id` has a symbol (always the case for ids returned by intern)
+    bool bound(SymbolId id) const {
+        return id < names_.size() && !names_[id].empty();
+    }
+
+    /**
+     * Resolve a symbol without interning it.
+     * @return The symbol's id, or kInvalidSymbol if it has never been seen.
+     */
+    SymbolId find(const char *raw, size_t len) const {
+        size_t n;
+        const SymbolId *id = ids_.find(make_key(raw, len, n));
+        return id ? *id : kInvalidSymbol;
+    }
+
+    SymbolId find(std::string_view name) const {
+        return find(name.data(), name.size());
+    }
+
+    // Number of interned symbols; valid ids are [0, size()) (see bind for gaps)
+    size_t size() const {
+        return names_.size();
+    }
+
+    const Symbol &name(SymbolId id) const {
+        return names_[id];
+    }
+
+    // NUL-padded symbol bytes, ready to memcpy into a protocol symbol field
+    const char *wire(SymbolId id) const {
+        return wire_[id].data();
+    }
+
+    const Instrument &instrument(SymbolId id) const {
+        return *instruments_[id];
+    }
+
+  private:
+    struct Key {
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+        bool operator==(const Key &) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return MixHash{}(key.lo ^ MixHash{}(key.hi));
+        }
+    };
+
+    // Pack the symbol, cut at the first NUL and with trailing spaces removed
+    static Key make_key(const char *raw, size_t len, size_t &n) {
+        n = 0;
+        while (n < len && n < kMaxLength && raw[n] != '\0') {
+            ++n;
+        }
+        while (n > 0 && raw[n - 1] == ' ') {
+            --n;
+        }
+        char buf[kMaxLength] = {};
+        std::memcpy(buf, raw, n);
+        Key key;
+        std::memcpy(&key.lo, buf, sizeof(key.lo));
+        std::memcpy(&key.hi, buf + sizeof(key.lo), sizeof(key.hi));
+        return key;
+    }
+
+    InstrumentRegistry &registry_;
+    FlatHashMap<Key, SymbolId, KeyHash> ids_;
+    std::vector<Symbol> names_;                      // id -> name
+    std::vector<std::array<char, kMaxLength>> wire_; // id -> padded wire bytes
+    std::vector<const Instrument *> instruments_;    // id -> reference data (stable refs)
+};
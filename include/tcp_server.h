@@ -1,20 +1,65 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <outbound_buffers.h>
+#include <thread>
+#include <utility>
+#include <vector>
 
+struct epoll_event;
+class IoUringBackend;
 
+/**
+ * Non-blocking TCP server on an edge-triggered epoll loop.
+ *
+ * Each ready socket is drained until EAGAIN and the listening socket accepts until
+ * its queue is empty, so the cost per event does not depend on how many sessions are
+ * open. The loop either spins (busy poll) or sleeps in epoll until a socket is ready;
+ * with an idle hook installed it wakes at least every `idle_timeout_us` to run it.
+ *
+ * Packets sent from the loop thread are queued per connection and written once per
+ * iteration with a gathered write; a socket that fills up keeps its queue until
+ * EPOLLOUT, so nothing is dropped. Only the loop thread writes to sockets: packets from
+ * other threads (the egress thread) are handed off to it and wake it through an eventfd,
+ * so their bytes can never interleave with the loop's own writes.
+ *
+ * Backend::IO_URING runs the same loop on io_uring instead (io_uring_backend.h) and
+ * falls back to epoll when the kernel lacks what it needs.
+ */
 class TcpServer {
   public:
     using OnMessage       = std::function<void(int fd, const char *data, size_t len)>;
     using OnConnection    = std::function<void(int fd)>;
     using OnDisconnection = std::function<void(int fd)>;
+    using OnIdle          = std::function<void()>;
+    using OnSlowConsumer  = std::function<void(int fd, size_t queued_bytes)>;
+    // Where the next recv for `fd` should land: pointer and free bytes
+    using OnRecvBuffer    = std::function<std::pair<char *, size_t>(int fd)>;
 
-    TcpServer(int port);
+    enum class Backend { EPOLL, IO_URING };
+
+    static constexpr int kListenBacklog = 4096;  // Capped by net.core.somaxconn
+    static constexpr int kMaxEvents     = 256;   // Ready sockets taken per epoll_wait
+    static constexpr size_t kRecvChunk  = 65536; // Bytes read per recv call
+    static constexpr size_t kMaxTrackedFds = 65536; // Connections with a generation, capped by RLIMIT_NOFILE
+
+    TcpServer(int port, bool busy_poll = false, int idle_timeout_us = 100,
+              Backend backend = Backend::EPOLL);
     ~TcpServer();
 
     void start();
+    // Make start() return after its current iteration. Safe from any thread.
+    void stop();
+    // Queue a packet; it is sent with the loop's next batch. Safe from any thread: other
+    // threads hand it to the loop, which drops it if the connection has closed meanwhile.
     void sendPacket(int fd, const char *data, size_t len);
+    // As above, for a reply to the connection of `generation` (see generation()): it is
+    // dropped if that connection has closed by the time the loop would send it.
+    void sendPacket(int fd, const char *data, size_t len, uint32_t generation);
 
     void setOnMessage(const OnMessage &callback) {
         onMessage_ = callback;
@@ -25,12 +70,87 @@ class TcpServer {
     void setOnDisconnection(const OnDisconnection &callback) {
         onDisconnection_ = callback;
     }
+    // Called once per event loop iteration, before waiting for socket activity. A timed
+    // hook also wakes the loop every idle_timeout_us; an untimed one only runs when
+    // sockets wake it anyway.
+    void setOnIdle(const OnIdle &callback, bool timed = true) {
+        onIdle_    = callback;
+        idleTimed_ = timed;
+    }
+    // Lets the epoll loop recv straight into the owner's per-connection buffer; the
+    // message callback then gets a pointer into that buffer. io_uring receives still
+    // arrive in its provided buffers.
+    void setRecvBuffer(const OnRecvBuffer &callback) {
+        recvBuffer_ = callback;
+    }
+    // Called when a connection's queued output grows past the high-water mark
+    void setOnSlowConsumer(const OnSlowConsumer &callback) {
+        onSlowConsumer_ = callback;
+    }
+    void setSendHighWater(size_t bytes) {
+        sendHighWater_ = bytes;
+    }
+    // A connection with more than `bytes` queued is dropped: its queue is discarded and
+    // the socket shut down, and the loop closes it as for any other hang-up
+    void setSendLimit(size_t bytes) {
+        sendLimit_ = bytes;
+    }
+    // Output queued for `fd` and not yet written, including packets still being handed
+    // to the loop. Safe from any thread; off the loop it may trail by one iteration.
+    size_t queuedBytes(int fd) const;
+    // Bumped when a connection on `fd` opens and when it closes, so odd while one is open.
+    // Tells a result meant for the connection served then from its fd's next owner.
+    // Safe from any thread.
+    uint32_t generation(int fd) const;
 
   private:
+    void acceptClients();
+    void readClient(int fd);
+    void closeClient(int fd);
+    void dropClient(int fd, size_t queued);
+    void handOff(int fd, const char *data, size_t len, uint32_t generation);
+    void drainHandoff();
+    void bumpGeneration(int fd);
+    int wait(epoll_event *events);
+    int waitTimeoutUs() const;
+
     int serverFd_;
+    int epollFd_;
     int port_;
+    bool busyPoll_;
+    int idleTimeoutUs_;
+    bool idleTimed_ = true;
+    bool hasPwait2_ = true; // epoll_pwait2 needs Linux 5.11; fall back to ms timeouts
+    std::unique_ptr<IoUringBackend> uring_;
+    OutboundBuffers outbox_; // Loop-thread output on the epoll backend
+    size_t sendHighWater_ = 1 << 20;
+    size_t sendLimit_     = 64 << 20;
+    std::atomic<std::thread::id> loopThread_;
+
+    // Packets from other threads: a header and the bytes each, sent by the loop thread
+    struct Handoff {
+        int fd;
+        uint32_t generation; // Of the connection the packet is for
+        uint32_t len;
+    };
+    std::mutex handoffMutex_;
+    std::vector<char> handoff_;      // Under handoffMutex_
+    std::vector<char> handoffBatch_; // Loop thread: the batch being sent
+    std::atomic<bool> handoffPending_{false};
+    int wakeFd_ = -1; // eventfd written when handoff_ becomes non-empty
+
+    // Per-fd count of closes, so a packet handed off for a connection that closed is
+    // not delivered to the next connection on the same fd number
+    size_t maxTrackedFds_ = 0;
+    std::unique_ptr<std::atomic<uint32_t>[]> generations_;
+    // Per-fd bytes in the loop's queues (mirrored by them) and in the handoff
+    std::unique_ptr<std::atomic<size_t>[]> queued_;
+    std::unique_ptr<std::atomic<size_t>[]> handedOff_;
     std::atomic<bool> running_;
     OnMessage onMessage_;
     OnConnection onConnection_;
     OnDisconnection onDisconnection_;
+    OnIdle onIdle_;
+    OnRecvBuffer recvBuffer_;
+    OnSlowConsumer onSlowConsumer_;
 };
\ No newline at end of file
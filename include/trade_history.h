@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <types.h>
+#include <vector>
+
+/**
+ * Session trade log with a fixed memory footprint.
+ *
+ * The most recent trades live in an in-memory ring. A trade pushed out of the ring
+ * is appended to a memory-mapped spill file as a fixed-size binary record, so the
+ * file is a dense array indexed by sequence number. Range queries read from either
+ * tier transparently. Without a spill file, trades older than the ring are dropped
+ * (with a warning when the first one goes).
+ */
+class TradeHistory {
+  public:
+    // On-disk form of a spilled trade (little-endian host layout, 72 bytes)
+    struct Record {
+        uint64_t sequence;
+        Timestamp timestamp;
+        Price price;
+        Quantity quantity;
+        OrderID buy_order_id;
+        OrderID sell_order_id;
+        UserID buy_user_id;
+        UserID sell_user_id;
+        SymbolId symbol;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(Record) == 72);
+
+    /**
+     * @param capacity Trades kept in memory (rounded up to a power of two).
+     * @param spill_path File that receives trades evicted from the ring; truncated
+     *        on open, and its directory created if missing. Empty disables spilling.
+     */
+    explicit TradeHistory(size_t capacity, const std::string &spill_path = "");
+    ~TradeHistory();
+
+    TradeHistory(const TradeHistory &)            = delete;
+    TradeHistory &operator=(const TradeHistory &) = delete;
+
+    /**
+     * Record a trade, spilling the oldest in-memory trade if the ring is full.
+     * @return The sequence number assigned to the trade (0, 1, 2, ...).
+     */
+    uint64_t append(const Trade &trade);
+
+    // Number of trades recorded this session (also the next sequence number)
+    uint64_t size() const {
+        return next_sequence_;
+    }
+
+    // Sequence number of the oldest trade that can still be queried
+    uint64_t first_available() const;
+
+    /**
+     * Trades with first <= sequence < last, oldest first. Trades that were dropped
+     * (no spill file, or spilling failed) are missing, so such a range comes back
+     * truncated; first_available() tells where the complete history starts.
+     */
+    std::vector<Trade> range_by_sequence(uint64_t first, uint64_t last) const;
+
+    /**
+     * Trades with from <= timestamp < to, oldest first; truncated like
+     * range_by_sequence if older trades were dropped.
+     * Binary-searches while trades arrive in timestamp order. Trades are stamped from
+     * the wall clock, which can step backwards; once a timestamp goes backwards the
+     * search would miss trades, so queries scan every available trade instead.
+     */
+    std::vector<Trade> range_by_time(Timestamp from, Timestamp to) const;
+
+  private:
+    static constexpr size_t kRecordsPerChunk = 65536; // 4.5 MiB, a whole number of pages
+
+    const Trade &ring_at(uint64_t sequence) const {
+        return ring_[sequence & (ring_.size() - 1)];
+    }
+
+    const Record &spilled_at(uint64_t sequence) const {
+        return chunks_[sequence / kRecordsPerChunk][sequence % kRecordsPerChunk];
+    }
+
+    Trade at(uint64_t sequence) const;
+    uint64_t ring_begin() const;
+    void spill(const Trade &trade);
+    bool map_chunk();
+
+    std::vector<Trade> ring_;          // Last ring_.size() trades, indexed by sequence
+    uint64_t next_sequence_ = 0;
+    int spill_fd_           = -1;
+    bool dropping_          = false;   // Evicted trades are being dropped (warned once)
+    bool time_ordered_      = true;    // No trade so far is stamped before its predecessor
+    Timestamp last_timestamp_ = 0;
+    std::vector<Record *> chunks_;     // Mapped windows of the spill file
+    uint64_t spilled_       = 0;       // Records written to the spill file
+};
@@ -1,16 +1,20 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
-#include <list>
 
 /* Type Aliases */
 using OrderID = uint64_t;      // 64-bit unique identifier for an order
 using UserID = uint64_t;       // 64-bit unique identifier for a user
-using Price = double;          // Price of an order
+using Price = int64_t;         // Price of an order, in integer ticks (see instrument.h)
 using Quantity = uint64_t;     // Quantity of an order
 using Timestamp = uint64_t;    // Timestamp of an order (nanoseconds since epoch)
 using Symbol = std::string;    // Symbol of an order (e.g., "BTCUSD")
+using SymbolId = uint32_t;     // Dense interned symbol index (see symbol_table.h)
+
+constexpr SymbolId kInvalidSymbol = static_cast<SymbolId>(-1);
 
 /* Enumerations */
 enum class OrderSide {
@@ -18,6 +22,11 @@ enum class OrderSide {
         SELL = 1,   // Sell order
 };
 
+// The side a taker on `side` trades against
+constexpr OrderSide opposite(OrderSide side) {
+        return side == OrderSide::BUY ? OrderSide::SELL : OrderSide::BUY;
+}
+
 enum class OrderType {
         LIMIT = 0,   // Execute at a specific price or better
         MARKET = 1,  // Execute immediately at the best available price
@@ -33,14 +42,22 @@ enum class OrderStatus {
         CANCELLED = 3, // Order has been cancelled
 };
 
+// What the engine did with an incoming order
+enum class OrderOutcome : uint8_t {
+        ACCEPTED = 0, // Matched and/or rested; MARKET and IOC remainders are cancelled
+        REJECTED = 1, // Refused before matching: invalid, not allowed now, or no pool slot
+        KILLED = 2,   // FOK that could not be filled completely
+};
+
 /* Core Structures */
 struct Order {
         // Identifiers
         OrderID id;
-        Symbol symbol;
+        SymbolId symbol = kInvalidSymbol;
 
         // User and Session Info
-        UserID user_id;              // ID of the user who placed the order
+        UserID user_id = 0;          // ID of the user who placed the order
+        uint32_t session = 0;        // Gateway session that sent it (0 = none, e.g. replayed)
 
         // Attributes
         OrderSide side;
@@ -53,7 +70,7 @@ struct Order {
         OrderStatus status = OrderStatus::NEW;  // Status of the order
 
         // Timestamps
-        Timestamp timestamp;         // Timestamp when created (nanoseconds since epoch)
+        Timestamp timestamp = 0;     // Timestamp when created (nanoseconds since epoch)
 
         // Convenience Methods
         bool is_filled() const { return quantity_filled >= quantity; }
@@ -63,15 +80,61 @@ struct Order {
         void reduce_quantity(Quantity qty) { quantity_filled += qty; }
 };
 
+/*
+ * Pooled representation of an order inside the engine, split by access pattern.
+ * RestingOrder holds exactly what matching and level walks touch and fills one
+ * cache line; OrderMeta holds the rest and lives in a parallel array indexed by
+ * RestingOrder::slot.
+ */
+struct alignas(64) RestingOrder {
+        OrderID id;
+        Price price;
+        Quantity quantity;
+        Quantity quantity_filled = 0;
+
+        // Intrusive FIFO links, owned by the price level while the order rests in a book
+        RestingOrder *prev = nullptr;
+        RestingOrder *next = nullptr;
+
+        uint32_t slot = 0;           // Index of this order's OrderMeta
+        OrderSide side;
+        OrderStatus status = OrderStatus::NEW;
+
+        bool is_filled() const { return quantity_filled >= quantity; }
+
+        Quantity remaining_qty() const { return quantity - quantity_filled; }
+
+        void reduce_quantity(Quantity qty) { quantity_filled += qty; }
+};
+
+constexpr uint32_t kNoSlot = static_cast<uint32_t>(-1);
+
+struct OrderMeta {
+        UserID user_id;              // ID of the user who placed the order
+        uint32_t session;            // Gateway session that sent it (0 = none)
+        Timestamp timestamp;         // Timestamp when created (nanoseconds since epoch)
+        SymbolId symbol;             // Book the order rests in
+        OrderType type;
+
+        // Intrusive list of the user's resting orders, by slot (see MatchingEngine::mass_cancel)
+        uint32_t user_prev = kNoSlot;
+        uint32_t user_next = kNoSlot;
+        bool in_user_list = false;
+};
+
+static_assert(sizeof(RestingOrder) == 64, "RestingOrder must fill exactly one cache line");
+static_assert(alignof(RestingOrder) == 64, "RestingOrder must start on a cache line");
+
 struct Trade {
         OrderID buy_order_id;        // ID of the buyer's order
         UserID buy_user_id;          // ID of the buyer
         OrderID sell_order_id;       // ID of the seller's order
         UserID sell_user_id;         // ID of the seller
-        Symbol symbol;               // Symbol of the asset traded
+        SymbolId symbol;             // Symbol of the asset traded
         Price price;                 // Price at which the trade was executed
         Quantity quantity;           // Quantity of the asset traded
         Timestamp timestamp;         // Timestamp when the trade was executed
+        uint64_t sequence = 0;       // Session-wide trade number (see trade_history.h)
 };
 
 /* Market Data Structures */
@@ -93,9 +156,27 @@ struct L2Quote {
         std::vector<std::pair<Price, Quantity>> asks;  // Top N asks
 };
 
-// Internal structures
-struct OrderInfo {
-        Order* order_ptr;                           // Pointer to the actual order in the order book
-        std::list<Order*>::iterator list_it;        // Iterator to the order in the price level list
+// Fixed-size, trivially copyable top of book: published snapshots and queue messages
+struct BookTop {
+        static constexpr size_t kDepth = 5;  // Levels per side
+        struct Level {
+                Price price;
+                Quantity quantity;
+        };
+        uint8_t num_bids = 0;
+        uint8_t num_asks = 0;
+        Level bids[kDepth] = {};
+        Level asks[kDepth] = {};
+};
+
+static_assert(std::is_trivially_copyable_v<BookTop>, "BookTop is published through a SeqLock");
+
+// Change to one price level's total quantity (see OrderBook::drain_level_updates)
+struct LevelUpdate {
+        enum class Action : uint8_t { ADD, CHANGE, DELETE };
+        Action action;
+        OrderSide side;
+        Price price;
+        Quantity quantity;           // Total at the level afterwards; 0 on DELETE
 };
 
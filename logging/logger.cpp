@@ -1,5 +1,7 @@
 #include "logger.hpp"
 #include <chrono>
+#include <cstdio>
+#include <ctime>
 
 #ifndef PROJECT_ROOT_PATH
 #define PROJECT_ROOT_PATH "."
@@ -9,12 +11,19 @@ Logger::Logger(const std::string &process_name) {
     std::filesystem::path logs_dir = std::filesystem::path(PROJECT_ROOT_PATH) / "logs";
     std::filesystem::create_directories(logs_dir);
 
-    // Create unique filename with sub-second timestamp
-    auto now       = std::chrono::system_clock::now();
-    std::string ts = std::format("{:%Y-%m-%d_%H-%M-%OS}", now);
-    std::replace(ts.begin(), ts.end(), ':', '-');
+    // Create unique filename with sub-second UTC timestamp: <name>_YYYY-MM-DD_HH-MM-SS.mmm.log.
+    // Built with strftime so the name does not depend on std::format's chrono support.
+    using namespace std::chrono;
+    auto now         = system_clock::now();
+    std::time_t secs = system_clock::to_time_t(now);
+    auto millis      = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
+    std::tm utc{};
+    gmtime_r(&secs, &utc);
+    char ts[32];
+    size_t n = std::strftime(ts, sizeof(ts), "%Y-%m-%d_%H-%M-%S", &utc);
+    std::snprintf(ts + n, sizeof(ts) - n, ".%03d", static_cast<int>(millis.count()));
 
-    file_.open(logs_dir / std::format("{}_{}.log", process_name, ts));
+    file_.open(logs_dir / (process_name + "_" + ts + ".log"));
 
     // Start the background consumer thread
     worker_thread_ = std::thread(&Logger::processLogs, this);
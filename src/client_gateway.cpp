@@ -10,73 +10,116 @@
 #include <logger.hpp>
 #include <optional>
 #include <order_book.h>
+#include <thread>
 
 
-namespace {
-std::string clean_symbol(const char *raw, size_t size) {
-    std::string s(raw, size);
-    // 1. Remove Null Bytes
-    s.erase(std::remove(s.begin(), s.end(), '\0'), s.end());
-    // 2. Remove Trailing Spaces
-    while (!s.empty() && std::isspace(s.back())) {
-        s.pop_back();
-    }
-    return s;
-}
-} // namespace
-
-ClientGateway::ClientGateway(MatchingEngine &engine, TcpServer &server)
-    : engine_(engine), server_(server) {
+ClientGateway::ClientGateway(MatchingEngine &engine, TcpServer &server, ShardedEngine *shards,
+                             bool pipeline)
+    : engine_(engine), server_(server), shards_(shards), pipeline_(shards && pipeline) {
 
     startLogging();
+    if (shards_) {
+        shard_trades_.resize(shards_->shards());
+    }
+    if (pipeline_) {
+        // Results are encoded and sent on their own thread, off the network thread
+        egress_running_ = true;
+        egress_thread_  = std::thread([this]() { runEgress(); });
+    } else if (shards_) {
+        server_.setOnIdle([this]() {
+            pollShards();
+            flushMarketData();
+        });
+    } else {
+        server_.setOnIdle([this]() { flushMarketData(); }, false);
+    }
     server_.setOnMessage(
         [this](int fd, const char *data, size_t len) { this->onMessage(fd, data, len); });
     server_.setOnConnection([this](int fd) { this->onConnection(fd); });
     server_.setOnDisconnection([this](int fd) { this->onDisconnection(fd); });
+    // epoll reads land directly in the session buffer and are decoded there
+    server_.setRecvBuffer([this](int fd) { return sessions_[fd].buffer.reserve(); });
+    server_.setOnSlowConsumer([](int fd, size_t queued_bytes) {
+        LOG_WARN << "Client " << fd << " is a slow consumer: " << queued_bytes
+                 << " bytes queued";
+    });
 }
 
 void ClientGateway::onConnection(int fd) {
     LOG_INFO << "Client connected: " << fd;
-    sessions_[fd] = Session();
+    if (static_cast<size_t>(fd) >= sessions_.size()) {
+        sessions_.resize(fd + 1);
+    }
+    sessions_[fd].reset(fd);
     // connection logged above
 }
 
 void ClientGateway::onDisconnection(int fd) {
     LOG_INFO << "Client disconnected: " << fd;
-    sessions_.erase(fd);
+    Session &session = sessions_[fd];
+    if (session.cancel_on_disconnect) {
+        // Only the orders sent on this session go; other sessions may share its user ids
+        for (UserID user : session.users) {
+            LOG_INFO << "Cancelling resting orders of user " << user << " on disconnect of client "
+                     << fd;
+            OrderMassCancelRequest req{};
+            req.header  = {0, MessageType::ORDER_MASS_CANCEL, sizeof(OrderMassCancelRequest)};
+            req.user_id = user;
+            req.scope   = 0;
+            massCancel(req, -1, false, session.id); // Nobody left to report to
+        }
+        // The shards log each cancel as it happens; let them finish so later requests are
+        // logged after the cancels, as they are applied
+        while (shards_ && shards_->pending() > 0) {
+            if (!pipeline_) {
+                pollShards();
+            }
+            std::this_thread::yield();
+        }
+    }
+    session.reset(-1);
 
-    for (auto &[symbol, subscribers] : market_data_subscriptions_) {
+    std::lock_guard<std::mutex> lock(subscriptions_mutex_);
+    for (auto &subscribers : market_data_subscriptions_) {
         subscribers.erase(fd);
     }
     // disconnection logged above
 }
 
 void ClientGateway::onMessage(int fd, const char *data, size_t len) {
-    auto &session = sessions_[fd];
-    session.buffer.insert(session.buffer.end(), data, data + len);
-    while (true) {
-        if (session.buffer.size() < sizeof(MessageHeader)) {
-            break;
-        }
-
-        // processing packet(s) from client
-
-        auto *header = reinterpret_cast<const MessageHeader *>(session.buffer.data());
-
-        if (header->msg_len > 1024 || header->msg_len < sizeof(MessageHeader)) {
-            LOG_ERROR << "Client " << fd << " sent invalid length: " << header->msg_len;
+    RecvBuffer &buffer = sessions_[fd].buffer;
+    if (data == buffer.write_ptr()) {
+        buffer.commit(len); // recv wrote into the buffer itself
+        decodeFrames(fd, buffer);
+        return;
+    }
+    // Received elsewhere (io_uring provided buffers): copy in as much as fits at a time
+    while (len > 0) {
+        size_t taken = buffer.append(data, len);
+        data += taken;
+        len -= taken;
+        if (!decodeFrames(fd, buffer)) {
             return;
         }
+    }
+}
 
-        if (session.buffer.size() < header->msg_len) {
+bool ClientGateway::decodeFrames(int fd, RecvBuffer &buffer) {
+    while (buffer.readable() >= sizeof(MessageHeader)) {
+        auto *header     = reinterpret_cast<const MessageHeader *>(buffer.read_ptr());
+        uint16_t msg_len = header->msg_len;
+        if (msg_len > RecvBuffer::kMaxFrame || msg_len < sizeof(MessageHeader)) {
+            LOG_ERROR << "Client " << fd << " sent invalid length: " << msg_len;
+            buffer.clear(); // Framing is lost; drop what is buffered
+            return false;
+        }
+        if (buffer.readable() < msg_len) {
             break;
         }
-        std::vector<char> msg_data(session.buffer.begin(),
-                                   session.buffer.begin() + header->msg_len);
-
-        processPacket(fd, msg_data.data());
-        session.buffer.erase(session.buffer.begin(), session.buffer.begin() + header->msg_len);
+        processPacket(fd, buffer.read_ptr()); // Decoded in place, no copy
+        buffer.consume(msg_len);
     }
+    return true;
 }
 
 void ClientGateway::processPacket(int fd, const char *data) {
@@ -100,6 +143,18 @@ void ClientGateway::processPacket(int fd, const char *data) {
         LOG_INFO << "Received order cancel request from client " << fd;
         auto *req = reinterpret_cast<const OrderCancelRequest *>(data);
         handleOrderCancel(fd, *req);
+    } else if (header->type == MessageType::ORDER_REPLACE) {
+        LOG_INFO << "Received order replace request from client " << fd;
+        auto *req = reinterpret_cast<const OrderReplaceRequest *>(data);
+        handleOrderReplace(fd, *req);
+    } else if (header->type == MessageType::ORDER_MASS_CANCEL) {
+        LOG_INFO << "Received mass cancel request from client " << fd;
+        auto *req = reinterpret_cast<const OrderMassCancelRequest *>(data);
+        handleMassCancel(fd, *req);
+    } else if (header->type == MessageType::TRADING_PHASE) {
+        LOG_INFO << "Received trading phase request from client " << fd;
+        auto *req = reinterpret_cast<const TradingPhaseRequest *>(data);
+        handleTradingPhase(fd, *req);
     } else {
         LOG_WARN << "Received unknown message type from client " << fd;
     }
@@ -108,6 +163,10 @@ void ClientGateway::processPacket(int fd, const char *data) {
 void ClientGateway::handleLogin(int fd, const LoginRequest &req) {
     sessions_[fd].logged_in = true;
     sessions_[fd].user_id   = fd;
+    sessions_[fd].id        = ++next_session_id_;
+    // Older clients send the request without the trailing option byte
+    sessions_[fd].cancel_on_disconnect =
+        req.header.msg_len >= sizeof(LoginRequest) && req.cancel_on_disconnect == 1;
 
     LoginResponse resp;
     resp.header = {0, MessageType::LOGIN_RESPONSE, sizeof(LoginResponse)};
@@ -126,11 +185,13 @@ void ClientGateway::handleNewOrder(int fd, const NewOrderRequest &req) {
         return;
     }
 
-    if (event_log_.is_open()) {
-        event_log_.write(reinterpret_cast<const char *>(&req), sizeof(NewOrderRequest));
-        event_log_.flush();
-    }
+    logEvent(req);
 
+    // Remember the order's owner for cancel-on-disconnect; sessions rarely use more than one
+    auto &users = sessions_[fd].users;
+    if (std::find(users.begin(), users.end(), req.user_id) == users.end()) {
+        users.push_back(req.user_id);
+    }
     handleNewOrderInternal(req, sessions_[fd].user_id, fd, false);
 }
 void ClientGateway::handleMarketDataRequest(int fd, const MarketDataRequest &req) {
@@ -138,31 +199,18 @@ void ClientGateway::handleMarketDataRequest(int fd, const MarketDataRequest &req
         LOG_WARN << "Client " << fd << " attempted to request market data without logging in";
         return;
     }
-    // Safely construct symbol string and trim trailing spaces / nulls
-    std::string symbol = clean_symbol(req.symbol, sizeof(req.symbol));
-    LOG_INFO << "Received market data request for symbol " << symbol << " from client " << fd;
-    OrderBook *book = engine_.get_order_book(symbol);
-    MarketDataSnapshot snapshot;
-    snapshot.header = {0, MessageType::MARKET_DATA_SNAPSHOT, sizeof(MarketDataSnapshot)};
-    strncpy(snapshot.symbol, symbol.c_str(), sizeof(snapshot.symbol) - 1);
-    snapshot.num_bids = 0;
-    snapshot.num_asks = 0;
-    if (!book) {
-        LOG_WARN << "No order book found for symbol " << symbol;
+    // Resolve the padded wire symbol without allocating
+    SymbolId symbol = engine_.symbols().find(req.symbol, sizeof(req.symbol));
+    LOG_INFO << "Received market data request for symbol "
+             << std::string_view(req.symbol, strnlen(req.symbol, sizeof(req.symbol)))
+             << " from client " << fd;
+    // Served from the published snapshot, so matching is never consulted or delayed
+    BookTop top;
+    if (!readSnapshot(symbol, top)) {
+        LOG_WARN << "No order book found for requested symbol";
         return;
-    } else {
-        auto l2_quote     = book->getL2Quote(5); // Get top 5 levels of the order book
-        snapshot.num_bids = l2_quote.bids.size();
-        snapshot.num_asks = l2_quote.asks.size();
-        for (size_t i = 0; i < snapshot.num_bids; ++i) {
-            snapshot.bids[i].price    = l2_quote.bids[i].first;
-            snapshot.bids[i].quantity = l2_quote.bids[i].second;
-        }
-        for (size_t i = 0; i < snapshot.num_asks; ++i) {
-            snapshot.asks[i].price    = l2_quote.asks[i].first;
-            snapshot.asks[i].quantity = l2_quote.asks[i].second;
-        }
     }
+    MarketDataSnapshot snapshot = makeSnapshot(symbol, top);
     server_.sendPacket(fd, reinterpret_cast<const char *>(&snapshot), sizeof(snapshot));
 }
 
@@ -170,23 +218,89 @@ void ClientGateway::handleNewOrderInternal(const NewOrderRequest &req, int user_
                                            bool is_replay) {
     // This function can be used for both live orders and replayed orders
     // For replayed orders, we might want to skip certain checks or logging
-    Order order;
+    std::optional<Order> decoded = decodeOrder(req, fd, is_replay);
+    if (!decoded) {
+        return;
+    }
+    const Order &order = *decoded;
+
+    if (!is_replay) {
+        LOG_INFO << "Processing new order from client " << fd << ": " << order.id;
+    }
+    submitOrder(order, fd, is_replay);
+}
+
+std::optional<Order> ClientGateway::decodeOrder(const NewOrderRequest &req, int fd,
+                                                bool is_replay) {
+    Order order{};
     order.id       = req.client_order_id;
     order.user_id  = req.user_id;
-    order.symbol   = clean_symbol(req.symbol, sizeof(req.symbol));
+    order.session  = is_replay ? 0 : sessions_[fd].id;
+    order.symbol   = engine_.symbols().intern(req.symbol, sizeof(req.symbol));
     order.side     = req.side == 0 ? OrderSide::BUY : OrderSide::SELL;
     order.type     = req.type == 0 ? OrderType::MARKET : OrderType::LIMIT;
-    order.price    = req.price;
     order.quantity = req.quantity;
 
-    if (!is_replay) {
-        LOG_INFO << "Processing new order from client " << fd << ": " << order.id;
+    if (order.symbol == kInvalidSymbol) {
+        LOG_WARN << "Order " << order.id << " has an empty symbol";
+        return std::nullopt;
+    }
+
+    // Convert the wire price to integer ticks; off-grid limit prices are rejected
+    const Instrument &inst = engine_.symbols().instrument(order.symbol);
+    if (order.type != OrderType::MARKET && !inst.is_on_tick(req.price)) {
+        LOG_WARN << "Order " << order.id << " price " << req.price
+                 << " is not on the tick grid for " << inst.symbol;
+        if (!is_replay) {
+            ExecutionReport report;
+            report.header          = {0, MessageType::EXECUTION_REPORT, sizeof(ExecutionReport)};
+            report.client_order_id = order.id;
+            report.execution_id    = 0;
+            report.user_id         = order.user_id;
+            std::memcpy(report.symbol, engine_.symbols().wire(order.symbol), sizeof(report.symbol));
+            report.side            = order.side == OrderSide::BUY ? 0 : 1;
+            report.price           = req.price;
+            report.quantity        = order.quantity;
+            report.filled_quantity = 0;
+            report.status          = 4; // Rejected
+            server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report));
+        }
+        return std::nullopt;
     }
+    order.price = inst.to_ticks(req.price);
+    return order;
+}
+
+void ClientGateway::submitOrder(const Order &order, int fd, bool is_replay) {
+    if (shards_) {
+        ShardedEngine::Command command{.kind      = ShardedEngine::Command::Kind::NEW_ORDER,
+                                       .quiet     = is_replay,
+                                       .fd        = fd,
+                                       .order     = order};
+        std::memcpy(command.symbol, engine_.symbols().wire(order.symbol), sizeof(command.symbol));
+        submitToShard(command);
+        return;
+    }
+    trade_buffer_.clear();
     auto start_time = std::chrono::high_resolution_clock::now();
-    auto trades     = engine_.process_new_order(order);
-    auto end_time   = std::chrono::high_resolution_clock::now();
+    OrderResult result = engine_.process_new_order(
+        order, [this](const Trade &trade) { trade_buffer_.push_back(trade); });
+    auto end_time = std::chrono::high_resolution_clock::now();
     auto latency_ns =
         std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+    OrderBook *book = engine_.get_order_book(order.symbol);
+    bool resting    = book && book->getOrderbyId(order.id);
+
+    onOrderProcessed(fd, server_.generation(fd), order, trade_buffer_, resting, result.outcome,
+                     latency_ns, is_replay);
+    if (!is_replay) {
+        markMarketData(order.symbol);
+    }
+}
+
+void ClientGateway::onOrderProcessed(int fd, uint32_t generation, Order order,
+                                     const std::vector<Trade> &trades, bool resting,
+                                     OrderOutcome outcome, int64_t latency_ns, bool is_replay) {
     if (is_replay) {
         LOG_DEBUG << "Replayed order " << order.id << " resulted in " << trades.size() << " trades";
         return; // Don't send execution reports for replayed orders
@@ -201,67 +315,84 @@ void ClientGateway::handleNewOrderInternal(const NewOrderRequest &req, int user_
         LOG_WARN << "SLOW MATCH DETECTED: " << latency_us << " us";
     }
 
+    const Instrument &inst = engine_.symbols().instrument(order.symbol);
     if (!trades.empty()) {
-        for (const auto &trade : trades) {
-            order.reduce_quantity(trade.quantity); // Update filled quantity
-            ExecutionReport report;
-            report.header          = {0, MessageType::EXECUTION_REPORT, sizeof(ExecutionReport)};
-            report.client_order_id = order.id;
-            report.execution_id =
-                trade.buy_order_id; // For simplicity, use buy order ID as execution ID
-            report.user_id = order.user_id;
-            strncpy(report.symbol, trade.symbol.c_str(), sizeof(report.symbol) - 1);
-            report.side            = order.side == OrderSide::BUY ? 0 : 1;
-            report.price           = trade.price;
-            report.quantity        = trade.quantity;
-            report.filled_quantity = order.quantity_filled;
-            report.status          = order.is_filled() ? 2 : 1; // 2=Filled, 1=Partially Filled
-
-            server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report));
-
-            // Send to otherside of user
-            ExecutionReport m_report;
-            m_report.header = {0, MessageType::EXECUTION_REPORT, sizeof(ExecutionReport)};
-            m_report.client_order_id =
-                (order.side == OrderSide::BUY) ? trade.sell_order_id : trade.buy_order_id;
-            m_report.execution_id = trade.buy_order_id;
-            m_report.user_id =
-                (order.side == OrderSide::SELL) ? trade.buy_order_id : trade.sell_order_id;
-            strncpy(m_report.symbol, trade.symbol.c_str(), sizeof(m_report.symbol) - 1);
-            m_report.side     = (order.side == OrderSide::BUY) ? 1 : 0; // Opposite of Taker
-            m_report.price    = trade.price;
-            m_report.quantity = trade.quantity;
-            auto getbook      = engine_.get_order_book(req.symbol);
-            auto getorder     = getbook->getOrderbyId(req.client_order_id);
-            if (getorder) {
-                m_report.filled_quantity = getorder->quantity_filled;
-                m_report.status          = 2;
-            } else {
-                // Filled
-                m_report.filled_quantity = trade.quantity;
-                m_report.status          = 2;
-            }
-            server_.sendPacket(fd, reinterpret_cast<const char *>(&m_report), sizeof(m_report));
-            broadcastTradeUpdate(trade); // Broadcast trade update to all clients
-
-            LOG_DEBUG << "Sent execution report to client " << fd << " for order " << order.id;
-        }
+        sendFillReports(fd, generation, order, trades, resting);
     } else {
         ExecutionReport report;
         report.header          = {0, MessageType::EXECUTION_REPORT, sizeof(ExecutionReport)};
         report.client_order_id = order.id;
         report.execution_id    = 0; // No execution
         report.user_id         = order.user_id;
-        strncpy(report.symbol, order.symbol.c_str(), sizeof(report.symbol) - 1);
+        std::memcpy(report.symbol, engine_.symbols().wire(order.symbol), sizeof(report.symbol));
         report.side            = order.side == OrderSide::BUY ? 0 : 1;
-        report.price           = order.price;
+        report.price           = inst.to_price(order.price);
         report.quantity        = order.quantity;
         report.filled_quantity = 0;
-        report.status          = 0; // 0=New, no execution
-        server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report));
+        // New if it rests; otherwise it was refused (pool limit, auction, invalid) or
+        // it was gone without a fill (FOK kill, MARKET or IOC against an empty book)
+        report.status = outcome == OrderOutcome::REJECTED ? 4 // Rejected
+                        : resting                         ? 0 // New
+                                                          : 3; // Canceled
+        server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report), generation);
         LOG_DEBUG << "No trades executed for client " << fd << " order " << order.id;
     }
-    broadcastMarketData(order.symbol);
+}
+
+// Execution reports to `fd` for the taker and maker of each trade, and a trade update
+// to subscribers. `order` is the taker as it was before these trades.
+void ClientGateway::sendFillReports(int fd, uint32_t generation, Order order,
+                                    const std::vector<Trade> &trades, bool resting) {
+    const Instrument &inst = engine_.symbols().instrument(order.symbol);
+    // Filled quantity of the taker once the whole order was matched
+    Quantity final_filled = order.quantity_filled;
+    for (const auto &trade : trades) {
+        final_filled += trade.quantity;
+    }
+    for (const auto &trade : trades) {
+        order.reduce_quantity(trade.quantity); // Update filled quantity
+        ExecutionReport report;
+        report.header          = {0, MessageType::EXECUTION_REPORT, sizeof(ExecutionReport)};
+        report.client_order_id = order.id;
+        report.execution_id =
+            trade.buy_order_id; // For simplicity, use buy order ID as execution ID
+        report.user_id = order.user_id;
+        std::memcpy(report.symbol, engine_.symbols().wire(trade.symbol), sizeof(report.symbol));
+        report.side            = order.side == OrderSide::BUY ? 0 : 1;
+        report.price           = inst.to_price(trade.price);
+        report.quantity        = trade.quantity;
+        report.filled_quantity = order.quantity_filled;
+        report.status          = order.is_filled() ? 2 : 1; // 2=Filled, 1=Partially Filled
+
+        server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report), generation);
+
+        // Send to otherside of user
+        ExecutionReport m_report;
+        m_report.header = {0, MessageType::EXECUTION_REPORT, sizeof(ExecutionReport)};
+        m_report.client_order_id =
+            (order.side == OrderSide::BUY) ? trade.sell_order_id : trade.buy_order_id;
+        m_report.execution_id = trade.buy_order_id;
+        m_report.user_id =
+            (order.side == OrderSide::SELL) ? trade.buy_order_id : trade.sell_order_id;
+        std::memcpy(m_report.symbol, engine_.symbols().wire(trade.symbol),
+                    sizeof(m_report.symbol));
+        m_report.side     = (order.side == OrderSide::BUY) ? 1 : 0; // Opposite of Taker
+        m_report.price    = inst.to_price(trade.price);
+        m_report.quantity = trade.quantity;
+        if (resting) {
+            m_report.filled_quantity = final_filled;
+            m_report.status          = 2;
+        } else {
+            // Filled
+            m_report.filled_quantity = trade.quantity;
+            m_report.status          = 2;
+        }
+        server_.sendPacket(fd, reinterpret_cast<const char *>(&m_report), sizeof(m_report),
+                           generation);
+        broadcastTradeUpdate(trade); // Broadcast trade update to all clients
+
+        LOG_DEBUG << "Sent execution report to client " << fd << " for order " << order.id;
+    }
 }
 
 void ClientGateway::replayEvents() {
@@ -273,53 +404,165 @@ void ClientGateway::replayEvents() {
         return;
     }
     LOG_INFO << "Replaying events from file: " << replay_file;
-    NewOrderRequest req;
-    while (infile.read(reinterpret_cast<char *>(&req), sizeof(NewOrderRequest))) {
-        handleNewOrderInternal(req, req.client_order_id, -1,
-                               true); // user_id and fd are not relevant for replay
+
+    // The log interleaves new orders, cancels and replaces; each record starts with its header.
+    // Runs of new orders between cancels are matched as one batch.
+    std::vector<Order> batch;
+    auto flush = [&]() {
+        engine_.process_orders(batch, [](const Trade &) {}); // No reports on replay
+        batch.clear();
+    };
+    MessageHeader header;
+    while (infile.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        infile.seekg(-static_cast<std::streamoff>(sizeof(header)), std::ios::cur);
+        if (header.type == MessageType::NEW_ORDER) {
+            NewOrderRequest req;
+            if (!infile.read(reinterpret_cast<char *>(&req), sizeof(req))) {
+                break;
+            }
+            std::optional<Order> order = decodeOrder(req, -1, true);
+            if (order && shards_) {
+                submitOrder(*order, -1, true); // Shards already batch through their inboxes
+            } else if (order) {
+                batch.push_back(*order);
+            }
+        } else if (header.type == MessageType::ORDER_CANCEL) {
+            OrderCancelRequest req;
+            if (!infile.read(reinterpret_cast<char *>(&req), sizeof(req))) {
+                break;
+            }
+            flush(); // The cancel may target an order from the pending batch
+            replayCancel(req);
+        } else if (header.type == MessageType::ORDER_REPLACE) {
+            OrderReplaceRequest req;
+            if (!infile.read(reinterpret_cast<char *>(&req), sizeof(req))) {
+                break;
+            }
+            flush();
+            replaceOrder(req, -1, true);
+        } else if (header.type == MessageType::ORDER_MASS_CANCEL) {
+            OrderMassCancelRequest req;
+            if (!infile.read(reinterpret_cast<char *>(&req), sizeof(req))) {
+                break;
+            }
+            flush();
+            massCancel(req, -1, true);
+        } else if (header.type == MessageType::TRADING_PHASE) {
+            TradingPhaseRequest req;
+            if (!infile.read(reinterpret_cast<char *>(&req), sizeof(req))) {
+                break;
+            }
+            flush(); // Orders before the switch belong to the previous phase
+            setTradingPhase(req, -1, true);
+        } else {
+            LOG_ERROR << "Unexpected message type in event log: " << static_cast<char>(header.type)
+                      << ". Stopping replay.";
+            break;
+        }
+    }
+    flush();
+    // Replayed orders must be in the books before live traffic is accepted
+    while (shards_ && shards_->pending() > 0) {
+        if (!pipeline_) {
+            pollShards();
+        }
+        std::this_thread::yield();
     }
     LOG_INFO << "Finished replaying events";
 }
 
+void ClientGateway::replayCancel(const OrderCancelRequest &req) {
+    SymbolId symbol = engine_.symbols().find(req.symbol, sizeof(req.symbol));
+    if (symbol == kInvalidSymbol) {
+        return; // No order for the symbol was ever replayed
+    }
+    if (shards_) {
+        ShardedEngine::Command command{.kind  = ShardedEngine::Command::Kind::CANCEL,
+                                       .quiet = true,
+                                       .fd    = -1};
+        command.order.id     = req.client_order_id;
+        command.order.symbol = symbol;
+        command.order.side   = req.side == 0 ? OrderSide::BUY : OrderSide::SELL;
+        std::memcpy(command.symbol, req.symbol, sizeof(command.symbol));
+        submitToShard(command);
+        return;
+    }
+    engine_.cancel_order(req.client_order_id, symbol, req.side);
+}
+
 void ClientGateway::handleSubscriptionRequest(int fd, const SubscriptionRequest &req) {
     if (!sessions_[fd].logged_in) {
         LOG_WARN << "Client " << fd << " attempted to subscribe to market data without logging in";
         return;
     }
-    std::string symbol = clean_symbol(req.symbol, sizeof(req.symbol));
-    if (req.is_subscribe) {
+    SymbolId symbol = engine_.symbols().intern(req.symbol, sizeof(req.symbol));
+    if (symbol == kInvalidSymbol) {
+        LOG_WARN << "Client " << fd << " sent a subscription request with an empty symbol";
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(subscriptions_mutex_);
+        if (symbol >= market_data_subscriptions_.size()) {
+            market_data_subscriptions_.resize(symbol + 1);
+        }
+        const Symbol &name = engine_.symbols().name(symbol);
+        if (!req.is_subscribe) {
+            market_data_subscriptions_[symbol].erase(fd);
+            LOG_INFO << "Client " << fd << " unsubscribed from market data for symbol " << name;
+            return;
+        }
+        // A subscriber that is already subscribed is asking to resync after a gap
         market_data_subscriptions_[symbol].insert(fd);
-        LOG_INFO << "Client " << fd << " subscribed to market data for symbol " << symbol;
-    } else {
-        market_data_subscriptions_[symbol].erase(fd);
-        LOG_INFO << "Client " << fd << " unsubscribed from market data for symbol " << symbol;
+        snapshot_requests_.emplace_back(symbol, fd);
+        snapshots_requested_.store(true, std::memory_order_release);
+        LOG_INFO << "Client " << fd << " subscribed to market data for symbol " << name;
     }
+    // Outside the lock: submitting to a shard may poll results, which take it
+    startLevelFeed(symbol);
+}
+
+void ClientGateway::startLevelFeed(SymbolId symbol) {
+    if (symbol >= levels_started_.size()) {
+        levels_started_.resize(symbol + 1);
+    }
+    if (levels_started_[symbol]) {
+        return;
+    }
+    levels_started_[symbol] = true;
+    if (shards_) {
+        // The levels come back as LEVEL events, then LEVELS_DONE marks the mirror complete
+        ShardedEngine::Command command{.kind = ShardedEngine::Command::Kind::LEVELS};
+        command.order.symbol = symbol;
+        std::memcpy(command.symbol, engine_.symbols().wire(symbol), sizeof(command.symbol));
+        submitToShard(command);
+        return;
+    }
+    engine_.get_or_create_order_book(symbol).start_level_updates(
+        [this, symbol](const LevelUpdate &update) { l2_feed_.apply(symbol, update); });
+    l2_feed_.set_ready(symbol);
 }
 
 void ClientGateway::broadcastTradeUpdate(const Trade &update) {
-    if (market_data_subscriptions_.find(update.symbol) == market_data_subscriptions_.end()) {
-        LOG_DEBUG << "No subscribers for symbol " << update.symbol
+    std::lock_guard<std::mutex> lock(subscriptions_mutex_);
+    if (!hasSubscribers(update.symbol)) {
+        LOG_DEBUG << "No subscribers for symbol " << engine_.symbols().name(update.symbol)
                   << ", skipping trade update broadcast";
         return;
     }
     TradeUpdate msg;
     msg.header = {0, MessageType::TRADE_UPDATE, sizeof(TradeUpdate)};
-    strncpy(msg.symbol, update.symbol.c_str(), sizeof(msg.symbol) - 1);
-    msg.price     = update.price;
+    std::memcpy(msg.symbol, engine_.symbols().wire(update.symbol), sizeof(msg.symbol));
+    msg.price     = engine_.symbols().instrument(update.symbol).to_price(update.price);
     msg.quantity  = update.quantity;
     msg.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
                         std::chrono::system_clock::now().time_since_epoch())
                         .count();
     msg.make_side = 0; // For simplicity, we won't determine maker/taker in this example
 
+    // Subscribing requires a login and disconnecting unsubscribes, so every
+    // subscriber is a logged-in session
     auto &subscribers = market_data_subscriptions_[update.symbol];
-    // Broadcast to all connected clients
     for (const auto &fd : subscribers) {
-        if (sessions_.find(fd) == sessions_.end() || !sessions_[fd].logged_in) {
-            LOG_WARN << "Skipping trade update for client " << fd
-                     << " because they are not logged in";
-            continue;
-        }
         server_.sendPacket(fd, reinterpret_cast<const char *>(&msg), sizeof(msg));
     }
 }
@@ -329,76 +572,503 @@ void ClientGateway::handleOrderCancel(int fd, const OrderCancelRequest &req) {
         LOG_WARN << "Client " << fd << " attempted to cancel order without logging in";
         return;
     }
-    if (event_log_.is_open()) {
-        event_log_.write(reinterpret_cast<const char *>(&req), sizeof(OrderCancelRequest));
-        event_log_.flush();
+    logEvent(req);
+    SymbolId symbol = engine_.symbols().find(req.symbol, sizeof(req.symbol));
+    LOG_INFO << "Processed order cancel request from client " << fd << " for order ID "
+             << req.client_order_id;
+    Order request{};
+    request.id      = req.client_order_id;
+    request.user_id = req.user_id;
+    request.symbol  = symbol;
+    request.side    = req.side == 0 ? OrderSide::BUY : OrderSide::SELL;
+    if (shards_ && symbol != kInvalidSymbol) {
+        ShardedEngine::Command command{.kind      = ShardedEngine::Command::Kind::CANCEL,
+                                       .fd        = fd,
+                                       .order     = request};
+        std::memcpy(command.symbol, req.symbol, sizeof(command.symbol));
+        submitToShard(command);
+        return;
     }
-    std::string symbol = clean_symbol(req.symbol, sizeof(req.symbol));
     std::optional<Order> cancelled_order =
         engine_.cancel_order(req.client_order_id, symbol, req.side);
-    LOG_INFO << "Processed order cancel request from client " << fd << " for order ID "
-             << req.client_order_id;
+    onOrderCancelled(fd, server_.generation(fd), request, req.symbol, cancelled_order);
+    if (symbol != kInvalidSymbol) {
+        markMarketData(symbol);
+    }
+}
+
+void ClientGateway::onOrderCancelled(int fd, uint32_t generation, const Order &request,
+                                     const char *wire_symbol,
+                                     const std::optional<Order> &cancelled_order) {
     ExecutionReport report;
     report.header          = {0, MessageType::EXECUTION_REPORT, sizeof(ExecutionReport)};
-    report.client_order_id = req.client_order_id;
-    report.user_id         = req.user_id;
+    report.client_order_id = request.id;
+    report.user_id         = request.user_id;
     report.execution_id    = 0; // No Trade
-    strncpy(report.symbol, symbol.c_str(), sizeof(report.symbol) - 1);
+    std::memcpy(report.symbol, wire_symbol, sizeof(report.symbol));
     if (cancelled_order) {
-        report.side            = cancelled_order->side == OrderSide::BUY ? 0 : 1;
-        report.price           = cancelled_order->price;
+        report.side  = cancelled_order->side == OrderSide::BUY ? 0 : 1;
+        report.price = engine_.symbols().instrument(request.symbol).to_price(cancelled_order->price);
         report.quantity        = cancelled_order->quantity;
         report.filled_quantity = cancelled_order->quantity_filled;
         report.status          = 3; // Canceled
     } else {
-        report.side            = req.side;
+        report.side            = request.side == OrderSide::BUY ? 0 : 1;
         report.price           = 0;
         report.quantity        = 0;
         report.filled_quantity = 0;
         report.status          = 4; // Reject - Order Not Found }
         LOG_WARN << "Order not found for cancellation request from client " << fd
-                 << " for order ID " << req.client_order_id;
+                 << " for order ID " << request.id;
     }
 
-    server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report));
-    broadcastMarketData(symbol);
+    server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report), generation);
 }
 
-void ClientGateway::broadcastMarketData(const std::string &symbol) {
-    if (market_data_subscriptions_.find(symbol) == market_data_subscriptions_.end()) {
-        return; // save cpu cycles ha ha
+void ClientGateway::handleOrderReplace(int fd, const OrderReplaceRequest &req) {
+    if (!sessions_[fd].logged_in) {
+        LOG_WARN << "Client " << fd << " attempted to replace order without logging in";
+        return;
     }
-    OrderBook *book = engine_.get_order_book(symbol);
+    logEvent(req); // One event, so replay applies it atomically like the engine does
+    replaceOrder(req, fd, false);
+}
+
+void ClientGateway::replaceOrder(const OrderReplaceRequest &req, int fd, bool is_replay) {
+    SymbolId symbol = engine_.symbols().find(req.symbol, sizeof(req.symbol));
+    Order request{};
+    request.id       = req.client_order_id;
+    request.user_id  = req.user_id;
+    request.symbol   = symbol;
+    request.side     = req.side == 0 ? OrderSide::BUY : OrderSide::SELL;
+    request.quantity = req.new_quantity;
+    if (symbol == kInvalidSymbol || !engine_.symbols().instrument(symbol).is_on_tick(req.new_price)) {
+        LOG_WARN << "Order " << request.id << " replace has an unknown symbol or off-tick price "
+                 << req.new_price;
+        if (!is_replay) {
+            onOrderReplaced(fd, server_.generation(fd), request, req.symbol, std::nullopt, {});
+        }
+        return;
+    }
+    request.price = engine_.symbols().instrument(symbol).to_ticks(req.new_price);
+
+    if (shards_) {
+        ShardedEngine::Command command{.kind      = ShardedEngine::Command::Kind::REPLACE,
+                                       .quiet     = is_replay,
+                                       .fd        = fd,
+                                       .order     = request};
+        std::memcpy(command.symbol, req.symbol, sizeof(command.symbol));
+        submitToShard(command);
+        return;
+    }
+    trade_buffer_.clear();
+    std::optional<Order> replaced =
+        engine_.modify_order(request.id, symbol, request.price, request.quantity,
+                             [this](const Trade &trade) { trade_buffer_.push_back(trade); });
+    if (!is_replay) {
+        onOrderReplaced(fd, server_.generation(fd), request, req.symbol, replaced,
+                        trade_buffer_);
+        markMarketData(symbol);
+    }
+}
+
+void ClientGateway::onOrderReplaced(int fd, uint32_t generation, const Order &request,
+                                    const char *wire_symbol,
+                                    const std::optional<Order> &replaced,
+                                    const std::vector<Trade> &trades) {
+    ExecutionReport report;
+    report.header          = {0, MessageType::EXECUTION_REPORT, sizeof(ExecutionReport)};
+    report.client_order_id = request.id;
+    report.user_id         = request.user_id;
+    report.execution_id    = 0; // No Trade
+    std::memcpy(report.symbol, wire_symbol, sizeof(report.symbol));
+    if (!replaced) {
+        report.side            = request.side == OrderSide::BUY ? 0 : 1;
+        report.price           = 0;
+        report.quantity        = 0;
+        report.filled_quantity = 0;
+        report.status          = 4; // Reject - Order Not Found or bad price
+        LOG_WARN << "Order not found for replace request from client " << fd << " for order ID "
+                 << request.id;
+        server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report), generation);
+        return;
+    }
+    if (!trades.empty()) {
+        // The new price crossed; report the fills against the order as it was before them
+        Order before = *replaced;
+        for (const auto &trade : trades) {
+            before.quantity_filled -= trade.quantity;
+        }
+        sendFillReports(fd, generation, before, trades, !replaced->is_filled());
+        if (replaced->is_filled()) {
+            return; // The last fill report already closed the order
+        }
+    }
+    report.side  = replaced->side == OrderSide::BUY ? 0 : 1;
+    report.price = engine_.symbols().instrument(request.symbol).to_price(replaced->price);
+    report.quantity        = replaced->quantity;
+    report.filled_quantity = replaced->quantity_filled;
+    report.status = replaced->status == OrderStatus::CANCELLED ? 3 : 5; // Canceled or Replaced
+    server_.sendPacket(fd, reinterpret_cast<const char *>(&report), sizeof(report), generation);
+}
+
+void ClientGateway::handleMassCancel(int fd, const OrderMassCancelRequest &req) {
+    if (!sessions_[fd].logged_in) {
+        LOG_WARN << "Client " << fd << " attempted to mass cancel without logging in";
+        return;
+    }
+    if (req.scope == 2 && !Config::getInstance().allow_symbol_mass_cancel) {
+        LOG_WARN << "Client " << fd << " attempted a symbol-wide mass cancel, which is disabled";
+        return;
+    }
+    logEvent(req);
+    massCancel(req, fd, false);
+}
+
+void ClientGateway::massCancel(const OrderMassCancelRequest &req, int fd, bool is_replay,
+                               uint32_t session) {
+    SymbolId symbol = kInvalidSymbol;
+    if (req.scope != 0) {
+        symbol = engine_.symbols().find(req.symbol, sizeof(req.symbol));
+        if (symbol == kInvalidSymbol) {
+            LOG_WARN << "Mass cancel for unknown symbol from client " << fd;
+            return; // Nothing can rest in a symbol that was never seen
+        }
+    }
+    if (shards_) {
+        ShardedEngine::Command command{.kind      = ShardedEngine::Command::Kind::MASS_CANCEL,
+                                       .quiet     = is_replay,
+                                       .all_users = req.scope == 2,
+                                       .fd        = fd};
+        command.order.user_id = req.user_id;
+        command.order.symbol  = symbol;
+        command.order.session = session;
+        if (symbol != kInvalidSymbol) {
+            std::memcpy(command.symbol, engine_.symbols().wire(symbol), sizeof(command.symbol));
+            submitToShard(command);
+        } else {
+            // The user's orders may rest on any shard
+            for (size_t shard = 0; shard < shards_->shards(); ++shard) {
+                submitToShard(command, shard);
+            }
+        }
+        return;
+    }
+    std::vector<Order> cancelled = req.scope == 2
+                                       ? engine_.cancel_all(symbol)
+                                       : engine_.mass_cancel(req.user_id, symbol, session);
+    if (is_replay) {
+        return;
+    }
+    std::vector<SymbolId> touched;
+    for (const Order &order : cancelled) {
+        if (fd >= 0) {
+            onOrderCancelled(fd, server_.generation(fd), order,
+                             engine_.symbols().wire(order.symbol), order);
+        } else {
+            logCancel(order);
+        }
+        touched.push_back(order.symbol);
+    }
+    // One market data update per symbol that lost orders
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (SymbolId s : touched) {
+        markMarketData(s);
+    }
+}
+
+void ClientGateway::logCancel(const Order &order) {
+    OrderCancelRequest req{};
+    req.header          = {0, MessageType::ORDER_CANCEL, sizeof(OrderCancelRequest)};
+    req.client_order_id = order.id;
+    req.user_id         = order.user_id;
+    std::memcpy(req.symbol, engine_.symbols().wire(order.symbol), sizeof(req.symbol));
+    req.side = order.side == OrderSide::BUY ? 0 : 1;
+    logEvent(req);
+}
+
+void ClientGateway::handleTradingPhase(int fd, const TradingPhaseRequest &req) {
+    if (!sessions_[fd].logged_in) {
+        LOG_WARN << "Client " << fd << " attempted to change the trading phase without logging in";
+        return;
+    }
+    if (!Config::getInstance().allow_trading_phase) {
+        LOG_WARN << "Client " << fd << " attempted to change the trading phase, which is disabled";
+        return;
+    }
+    logEvent(req);
+    setTradingPhase(req, fd, false);
+}
+
+void ClientGateway::setTradingPhase(const TradingPhaseRequest &req, int fd, bool is_replay) {
+    // An auction may open before the first order, so the symbol is interned here
+    SymbolId symbol = engine_.symbols().intern(req.symbol, sizeof(req.symbol));
+    if (symbol == kInvalidSymbol) {
+        LOG_WARN << "Trading phase request with an empty symbol from client " << fd;
+        return;
+    }
+    const bool auction = req.phase == 1;
+    if (shards_) {
+        ShardedEngine::Command command{.kind      = ShardedEngine::Command::Kind::PHASE,
+                                       .quiet     = is_replay,
+                                       .auction   = auction,
+                                       .fd        = fd};
+        command.order.symbol = symbol;
+        std::memcpy(command.symbol, engine_.symbols().wire(symbol), sizeof(command.symbol));
+        submitToShard(command);
+        return;
+    }
+    if (auction) {
+        engine_.begin_auction(symbol);
+        return;
+    }
+    trade_buffer_.clear();
+    engine_.uncross(symbol, [this](const Trade &trade) { trade_buffer_.push_back(trade); });
+    if (is_replay) {
+        return;
+    }
+    for (const Trade &trade : trade_buffer_) {
+        broadcastTradeUpdate(trade);
+    }
+    markMarketData(symbol);
+}
+
+bool ClientGateway::hasSubscribers(SymbolId symbol) const {
+    return symbol < market_data_subscriptions_.size() && !market_data_subscriptions_[symbol].empty();
+}
+
+bool ClientGateway::readSnapshot(SymbolId symbol, BookTop &top) const {
+    return shards_ ? shards_->read_snapshot(symbol, top) : engine_.read_snapshot(symbol, top);
+}
+
+MarketDataSnapshot ClientGateway::makeSnapshot(SymbolId symbol, const BookTop &top) {
     MarketDataSnapshot snapshot;
     snapshot.header = {0, MessageType::MARKET_DATA_SNAPSHOT, sizeof(MarketDataSnapshot)};
-    strncpy(snapshot.symbol, symbol.c_str(), sizeof(snapshot.symbol) - 1);
-    snapshot.num_bids = 0;
-    snapshot.num_asks = 0;
-    if (!book) {
-        LOG_WARN << "No order book found for symbol " << symbol;
+    std::memcpy(snapshot.symbol, engine_.symbols().wire(symbol), sizeof(snapshot.symbol));
+    const Instrument &inst = engine_.symbols().instrument(symbol);
+    snapshot.num_bids      = top.num_bids;
+    snapshot.num_asks      = top.num_asks;
+    for (size_t i = 0; i < snapshot.num_bids; ++i) {
+        snapshot.bids[i].price    = inst.to_price(top.bids[i].price);
+        snapshot.bids[i].quantity = top.bids[i].quantity;
+    }
+    for (size_t i = 0; i < snapshot.num_asks; ++i) {
+        snapshot.asks[i].price    = inst.to_price(top.asks[i].price);
+        snapshot.asks[i].quantity = top.asks[i].quantity;
+    }
+    return snapshot;
+}
+
+void ClientGateway::markMarketData(SymbolId symbol) {
+    if (symbol >= market_data_.size()) {
+        market_data_.resize(symbol + 1);
+    }
+    MarketDataSlot &slot = market_data_[symbol];
+    if (!slot.pending) {
+        slot.pending = true;
+        market_data_pending_.push_back(symbol);
+    }
+}
+
+void ClientGateway::flushMarketData() {
+    if (market_data_pending_.empty() && !snapshots_requested_.load(std::memory_order_acquire)) {
         return;
-    } else {
-        auto l2_quote     = book->getL2Quote(5); // Get top 5 levels of the order book
-        snapshot.num_bids = l2_quote.bids.size();
-        snapshot.num_asks = l2_quote.asks.size();
-        for (size_t i = 0; i < snapshot.num_bids; ++i) {
-            snapshot.bids[i].price    = l2_quote.bids[i].first;
-            snapshot.bids[i].quantity = l2_quote.bids[i].second;
+    }
+    std::lock_guard<std::mutex> lock(subscriptions_mutex_);
+    snapshots_requested_.store(false, std::memory_order_relaxed);
+    for (const auto &[symbol, fd] : snapshot_requests_) {
+        markMarketData(symbol);
+        auto &awaiting = market_data_[symbol].awaiting;
+        if (std::find(awaiting.begin(), awaiting.end(), fd) == awaiting.end()) {
+            awaiting.push_back(fd);
         }
-        for (size_t i = 0; i < snapshot.num_asks; ++i) {
-            snapshot.asks[i].price    = l2_quote.asks[i].first;
-            snapshot.asks[i].quantity = l2_quote.asks[i].second;
+    }
+    snapshot_requests_.clear();
+    // Symbols with subscribers still owed a snapshot stay listed and are retried next time
+    size_t kept = 0;
+    for (SymbolId symbol : market_data_pending_) {
+        MarketDataSlot &slot = market_data_[symbol];
+        publishMarketData(symbol, slot);
+        if (!slot.awaiting.empty()) {
+            market_data_pending_[kept++] = symbol;
+        } else {
+            slot.pending = false;
         }
     }
-    auto &subscribers = market_data_subscriptions_[symbol];
-    for (const auto &fd : subscribers) {
-        if (sessions_.find(fd) != sessions_.end() && sessions_[fd].logged_in) {
-            server_.sendPacket(fd, reinterpret_cast<const char *>(&snapshot), sizeof(snapshot));
+    market_data_pending_.resize(kept);
+}
+
+void ClientGateway::publishMarketData(SymbolId symbol, MarketDataSlot &slot) {
+    if (!shards_) {
+        // Inline matching: the book has been recording its level changes since the last flush
+        OrderBook *book = engine_.get_order_book(symbol);
+        if (book && book->records_level_updates()) {
+            book->drain_level_updates(
+                [&](const LevelUpdate &update) { l2_feed_.apply(symbol, update); });
+        }
+    }
+    if (!l2_feed_.ready(symbol)) {
+        return; // Snapshot requests wait until the feed has the whole book
+    }
+    const std::set<int> *subscribers =
+        hasSubscribers(symbol) ? &market_data_subscriptions_[symbol] : nullptr;
+    L2Feed::WireSymbol wire;
+    std::memcpy(wire, engine_.symbols().wire(symbol), sizeof(wire));
+    const Instrument &inst = engine_.symbols().instrument(symbol);
+    auto &awaiting         = slot.awaiting;
+
+    // Encoded once, even without subscribers, so sequence numbers track every change
+    update_buffer_.clear();
+    if (l2_feed_.encode_updates(symbol, wire, inst, update_buffer_) > 0 && subscribers) {
+        for (int fd : *subscribers) {
+            if (std::find(awaiting.begin(), awaiting.end(), fd) != awaiting.end()) {
+                continue; // Its snapshot already includes these changes
+            }
+            if (server_.queuedBytes(fd) > kMarketDataBacklog) {
+                awaiting.push_back(fd); // Drop its deltas; resync by snapshot once drained
+                continue;
+            }
+            server_.sendPacket(fd, update_buffer_.data(), update_buffer_.size());
+        }
+    }
+
+    snapshot_buffer_.clear();
+    size_t kept = 0;
+    for (int fd : awaiting) {
+        if (!subscribers || !subscribers->count(fd)) {
+            continue; // Unsubscribed or disconnected meanwhile
+        }
+        if (server_.queuedBytes(fd) > kMarketDataBacklog) {
+            awaiting[kept++] = fd;
+            continue;
+        }
+        if (snapshot_buffer_.empty()) {
+            l2_feed_.encode_snapshot(symbol, wire, inst, snapshot_buffer_);
+        }
+        server_.sendPacket(fd, snapshot_buffer_.data(), snapshot_buffer_.size());
+    }
+    awaiting.resize(kept);
+}
+
+void ClientGateway::submitToShard(const ShardedEngine::Command &command) {
+    submitToShard(command, shards_->shard_of(command.order.symbol));
+}
+
+void ClientGateway::submitToShard(const ShardedEngine::Command &command, size_t shard) {
+    // Tie the results to this connection rather than to whoever holds its fd when they land
+    ShardedEngine::Command stamped = command;
+    stamped.generation             = server_.generation(command.fd);
+    // Back-pressure: while the shard's inbox is full, keep draining results so it can
+    // progress (in pipeline mode the egress thread is already doing that)
+    while (!shards_->try_submit_to(shard, stamped)) {
+        if (!pipeline_) {
+            pollShards();
+        }
+        std::this_thread::yield();
+    }
+}
+
+size_t ClientGateway::pollShards() {
+    return shards_->poll([this](size_t shard, const ShardedEngine::Event &event) {
+        onShardEvent(shard, event);
+    });
+}
+
+void ClientGateway::runEgress() {
+    while (egress_running_.load(std::memory_order_acquire)) {
+        size_t polled = pollShards();
+        flushMarketData();
+        if (polled == 0) {
+            std::this_thread::yield();
         }
     }
+    pollShards(); // Send whatever was already queued
+    flushMarketData();
+}
+
+void ClientGateway::onShardEvent(size_t shard, const ShardedEngine::Event &event) {
+    using Kind = ShardedEngine::Event::Kind;
+    SymbolId symbol = event.order.symbol;
+    // The client that sent the command has gone and its fd may be another client's now:
+    // its reports are dropped, while trades still go out to market data subscribers
+    bool closed =
+        !event.quiet && event.fd >= 0 && server_.generation(event.fd) != event.generation;
+    if (closed && event.kind != Kind::TRADE && event.kind != Kind::CANCELLED) {
+        LOG_INFO << "Dropping the reports of a command from closed client " << event.fd;
+    }
+    switch (event.kind) {
+    case Kind::TRADE:
+        shard_trades_[shard].push_back(event.trade);
+        return;
+    case Kind::ORDER_DONE:
+        if (closed) {
+            for (const Trade &trade : shard_trades_[shard]) {
+                broadcastTradeUpdate(trade);
+            }
+        } else {
+            onOrderProcessed(event.fd, event.generation, event.order, shard_trades_[shard],
+                             event.found, event.outcome, event.latency_ns, event.quiet);
+        }
+        shard_trades_[shard].clear();
+        break;
+    case Kind::CANCEL_DONE:
+        if (event.quiet || closed) {
+            return; // Replayed cancel, or nobody to tell
+        }
+        onOrderCancelled(event.fd, event.generation, event.order, engine_.symbols().wire(symbol),
+                         event.found ? std::optional<Order>(event.order) : std::nullopt);
+        break;
+    case Kind::REPLACE_DONE:
+        if (closed) {
+            for (const Trade &trade : shard_trades_[shard]) {
+                broadcastTradeUpdate(trade);
+            }
+        } else if (!event.quiet) {
+            onOrderReplaced(event.fd, event.generation, event.order,
+                            engine_.symbols().wire(symbol),
+                            event.found ? std::optional<Order>(event.order) : std::nullopt,
+                            shard_trades_[shard]);
+        }
+        shard_trades_[shard].clear();
+        break;
+    case Kind::CANCELLED:
+        if (closed) {
+            break; // The mass cancel request itself is in the event log
+        }
+        if (!event.quiet && event.fd >= 0) {
+            onOrderCancelled(event.fd, event.generation, event.order,
+                             engine_.symbols().wire(symbol), event.order);
+        } else if (!event.quiet) {
+            logCancel(event.order); // Cancel-on-disconnect of a closed session
+        }
+        break;
+    case Kind::MASS_CANCEL_DONE:
+        return;
+    case Kind::PHASE_DONE:
+        if (!event.quiet) {
+            for (const Trade &trade : shard_trades_[shard]) {
+                broadcastTradeUpdate(trade);
+            }
+        }
+        shard_trades_[shard].clear();
+        break;
+    case Kind::LEVEL:
+        l2_feed_.apply(symbol, event.level);
+        markMarketData(symbol);
+        break;
+    case Kind::LEVELS_DONE:
+        l2_feed_.set_ready(symbol);
+        markMarketData(symbol);
+        break;
+    }
 }
 
 ClientGateway::~ClientGateway() {
+    if (egress_thread_.joinable()) {
+        egress_running_ = false;
+        egress_thread_.join();
+    }
     if (event_log_.is_open()) {
         event_log_.close();
     }
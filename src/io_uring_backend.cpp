@@ -0,0 +1,460 @@
+#include <io_uring_backend.h>
+
+#include "logger.hpp"
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// Kind of operation in the top half of user_data; the fd is in the bottom half
+enum Op : uint64_t { kAccept = 1, kRecv = 2, kSend = 3, kWake = 4 };
+
+constexpr uint16_t kBufferGroup = 0;
+
+uint64_t tag(Op op, int fd) {
+    return static_cast<uint64_t>(op) << 32 | static_cast<uint32_t>(fd);
+}
+
+int sysSetup(unsigned entries, io_uring_params *params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sysEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+             const void *arg, size_t arg_size) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+int sysRegister(int ring_fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+} // namespace
+
+std::unique_ptr<IoUringBackend> IoUringBackend::create(int listen_fd, int wake_fd) {
+    std::unique_ptr<IoUringBackend> backend(new IoUringBackend());
+    if (!backend->init(listen_fd, wake_fd)) {
+        return nullptr;
+    }
+    return backend;
+}
+
+bool IoUringBackend::init(int listen_fd, int wake_fd) {
+    listen_fd_ = listen_fd;
+    wake_fd_   = wake_fd;
+
+    // Room for a burst of completions (one per received chunk) beyond the SQ depth
+    io_uring_params params{};
+    params.flags      = IORING_SETUP_CQSIZE;
+    params.cq_entries = kQueueDepth * 4;
+    ring_fd_          = sysSetup(kQueueDepth, &params);
+    if (ring_fd_ < 0) {
+        LOG_WARN << "io_uring_setup failed: " << std::strerror(errno);
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        LOG_WARN << "io_uring lacks single mmap or timed waits (needs Linux 5.11+)";
+        return false;
+    }
+
+    ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                          params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    ring_      = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    ring_ = ring_ == MAP_FAILED ? nullptr : ring_;
+    sqes_ = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe *>(sqes);
+    if (!ring_ || !sqes_) {
+        LOG_WARN << "Failed to map the io_uring rings: " << std::strerror(errno);
+        return false;
+    }
+
+    char *ring  = static_cast<char *>(ring_);
+    sq_head_    = reinterpret_cast<unsigned *>(ring + params.sq_off.head);
+    sq_tail_    = reinterpret_cast<unsigned *>(ring + params.sq_off.tail);
+    sq_array_   = reinterpret_cast<unsigned *>(ring + params.sq_off.array);
+    sq_mask_    = *reinterpret_cast<unsigned *>(ring + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+    cq_head_    = reinterpret_cast<unsigned *>(ring + params.cq_off.head);
+    cq_tail_    = reinterpret_cast<unsigned *>(ring + params.cq_off.tail);
+    cq_mask_    = *reinterpret_cast<unsigned *>(ring + params.cq_off.ring_mask);
+    cqes_       = reinterpret_cast<io_uring_cqe *>(ring + params.cq_off.cqes);
+
+    // Sparse registered file table; without it sockets are looked up per operation
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    io_uring_rsrc_register files{};
+    files.nr    = static_cast<unsigned>(std::min<rlim_t>(limit.rlim_cur, kMaxFiles));
+    files.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (sysRegister(ring_fd_, IORING_REGISTER_FILES2, &files, sizeof(files)) == 0) {
+        max_files_ = files.nr;
+    } else {
+        LOG_WARN << "io_uring registered files unavailable: " << std::strerror(errno);
+    }
+
+    // Provided buffer ring for multishot receives
+    void *buf_ring = mmap(nullptr, kBufferCount * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void *buffers  = mmap(nullptr, kBufferCount * kBufferSize, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    buf_ring_ = buf_ring == MAP_FAILED ? nullptr : static_cast<io_uring_buf_ring *>(buf_ring);
+    buffers_  = buffers == MAP_FAILED ? nullptr : static_cast<char *>(buffers);
+    if (!buf_ring_ || !buffers_) {
+        LOG_WARN << "Failed to allocate io_uring receive buffers";
+        return false;
+    }
+    io_uring_buf_reg reg{};
+    reg.ring_addr    = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = kBufferCount;
+    reg.bgid         = kBufferGroup;
+    if (sysRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        LOG_WARN << "io_uring provided buffer rings unavailable (needs Linux 5.19+): "
+                 << std::strerror(errno);
+        return false;
+    }
+    for (unsigned bid = 0; bid < kBufferCount; ++bid) {
+        recycleBuffer(bid);
+    }
+
+    armAccept();
+    armWake();
+    enter(0);
+    LOG_INFO << "io_uring backend ready (" << kBufferCount << " receive buffers, " << max_files_
+             << " registered file slots)";
+    return true;
+}
+
+IoUringBackend::~IoUringBackend() {
+    for (size_t fd = 0; fd < connections_.size(); ++fd) {
+        if (connections_[fd].open || connections_[fd].closing) {
+            close(static_cast<int>(fd));
+        }
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_); // Cancels whatever is still armed
+    }
+    if (ring_) {
+        munmap(ring_, ring_size_);
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (buf_ring_) {
+        munmap(buf_ring_, kBufferCount * sizeof(io_uring_buf));
+    }
+    if (buffers_) {
+        munmap(buffers_, kBufferCount * kBufferSize);
+    }
+}
+
+void IoUringBackend::poll(int timeout_us, const TcpServer::OnConnection &on_connection,
+                          const TcpServer::OnMessage &on_message,
+                          const TcpServer::OnDisconnection &on_disconnection) {
+    flushSends();
+    enter(timeout_us);
+
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+        const uint64_t data     = cqe.user_data;
+        const int result        = cqe.res;
+        const bool more         = cqe.flags & IORING_CQE_F_MORE;
+        const unsigned bid      = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        const int fd            = static_cast<int>(static_cast<uint32_t>(data));
+
+        switch (static_cast<Op>(data >> 32)) {
+        case kAccept:
+            if (result >= 0) {
+                openConnection(result, on_connection);
+            } else if (result != -EAGAIN && result != -EINTR && result != -ECONNABORTED) {
+                LOG_WARN << "accept failed: " << std::strerror(-result);
+            }
+            if (!more) {
+                armAccept();
+            }
+            break;
+        case kRecv:
+            if (result > 0) {
+                if (on_message && connections_[fd].open) {
+                    on_message(fd, buffers_ + bid * kBufferSize, static_cast<size_t>(result));
+                }
+                recycleBuffer(bid);
+                if (!more && connections_[fd].open) {
+                    armRecv(fd);
+                }
+            } else if (result == -ENOBUFS) {
+                // Every buffer was in use; earlier completions gave them back
+                if (connections_[fd].open) {
+                    armRecv(fd);
+                }
+            } else if (!more) {
+                closeConnection(fd, on_disconnection); // Orderly shutdown or a socket error
+            }
+            break;
+        case kSend:
+            onSent(fd, result);
+            break;
+        case kWake:
+            if (result >= 0) {
+                uint64_t count; // Reset the eventfd; the caller drains the handoff next
+                if (read(wake_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    LOG_WARN << "Failed to read the wakeup eventfd: " << std::strerror(errno);
+                }
+            }
+            armWake();
+            break;
+        }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+size_t IoUringBackend::send(int fd, const char *data, size_t len) {
+    if (fd < 0 || static_cast<size_t>(fd) >= connections_.size() || !connections_[fd].open) {
+        return 0;
+    }
+    Connection &conn = connections_[fd];
+    conn.pending.insert(conn.pending.end(), data, data + len);
+    if (!conn.queued) {
+        conn.queued = true;
+        dirty_.push_back(fd);
+    }
+    publish(fd);
+    return queued(fd);
+}
+
+void IoUringBackend::discard(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= connections_.size()) {
+        return;
+    }
+    connections_[fd].pending.clear();
+    publish(fd);
+}
+
+io_uring_sqe *IoUringBackend::nextSqe() {
+    if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_) {
+        enter(0); // Queue full: hand what is there to the kernel first
+    }
+    unsigned index    = sq_local_tail_ & sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    return sqe;
+}
+
+void IoUringBackend::enter(int timeout_us) {
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    unsigned to_submit = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (to_submit == 0 && timeout_us == 0) {
+        return; // Nothing to submit and no wait: completions are read from memory
+    }
+    unsigned flags        = 0;
+    unsigned min_complete = 0;
+    __kernel_timespec timeout{};
+    io_uring_getevents_arg arg{};
+    const void *arg_ptr = nullptr;
+    size_t arg_size     = 0;
+    if (timeout_us != 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        min_complete = 1;
+        if (timeout_us > 0) {
+            timeout.tv_sec  = timeout_us / 1000000;
+            timeout.tv_nsec = (timeout_us % 1000000) * 1000L;
+            arg.ts          = reinterpret_cast<uint64_t>(&timeout);
+            arg.sigmask_sz  = _NSIG / 8;
+            flags |= IORING_ENTER_EXT_ARG;
+            arg_ptr  = &arg;
+            arg_size = sizeof(arg);
+        }
+    }
+    if (sysEnter(ring_fd_, to_submit, min_complete, flags, arg_ptr, arg_size) < 0 &&
+        errno != EINTR && errno != ETIME && errno != EBUSY && errno != EAGAIN) {
+        LOG_WARN << "io_uring_enter failed: " << std::strerror(errno);
+    }
+}
+
+void IoUringBackend::armAccept() {
+    io_uring_sqe *sqe = nextSqe();
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = listen_fd_;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data    = tag(kAccept, listen_fd_);
+}
+
+void IoUringBackend::armWake() {
+    io_uring_sqe *sqe  = nextSqe();
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = wake_fd_;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data     = tag(kWake, wake_fd_);
+}
+
+void IoUringBackend::armRecv(int fd) {
+    io_uring_sqe *sqe = nextSqe();
+    sqe->opcode       = IORING_OP_RECV;
+    sqe->fd           = fd;
+    sqe->flags        = IOSQE_BUFFER_SELECT | (connections_[fd].fixed ? IOSQE_FIXED_FILE : 0);
+    sqe->ioprio       = IORING_RECV_MULTISHOT;
+    sqe->buf_group    = kBufferGroup;
+    sqe->user_data    = tag(kRecv, fd);
+}
+
+void IoUringBackend::flushSends() {
+    for (int fd : dirty_) {
+        Connection &conn = connections_[fd];
+        conn.queued      = false;
+        if (!conn.open || conn.sending) {
+            continue; // onSent picks the connection up again
+        }
+        if (conn.inflight.empty()) {
+            conn.inflight.swap(conn.pending);
+            conn.inflight_sent = 0;
+        }
+        if (conn.inflight.empty()) {
+            continue;
+        }
+        io_uring_sqe *sqe = nextSqe();
+        sqe->opcode       = IORING_OP_SEND;
+        sqe->fd           = fd;
+        sqe->flags        = conn.fixed ? IOSQE_FIXED_FILE : 0;
+        sqe->addr         = reinterpret_cast<uint64_t>(conn.inflight.data() + conn.inflight_sent);
+        sqe->len          = static_cast<uint32_t>(conn.inflight.size() - conn.inflight_sent);
+        sqe->msg_flags    = MSG_NOSIGNAL;
+        sqe->user_data    = tag(kSend, fd);
+        conn.sending      = true;
+    }
+    dirty_.clear();
+}
+
+void IoUringBackend::onSent(int fd, int result) {
+    Connection &conn = connections_[fd];
+    conn.sending     = false;
+    if (conn.closing) {
+        releaseConnection(fd);
+        return;
+    }
+    if (result > 0) {
+        conn.inflight_sent += static_cast<size_t>(result);
+    } else {
+        LOG_WARN << "Send to client " << fd << " failed: " << std::strerror(-result);
+    }
+    if (result <= 0 || conn.inflight_sent == conn.inflight.size()) {
+        conn.inflight.clear();
+        conn.inflight_sent = 0;
+    }
+    publish(fd);
+    // A short send resumes from where it stopped before anything queued after it
+    if ((!conn.inflight.empty() || !conn.pending.empty()) && !conn.queued) {
+        conn.queued = true;
+        dirty_.push_back(fd);
+    }
+}
+
+void IoUringBackend::recycleBuffer(unsigned bid) {
+    // Index the entries as a plain array: in C++ the header's flexible-array member
+    // lands at offset 8. Fields are set one by one because the ring's tail shares
+    // memory with the first entry.
+    io_uring_buf &buf = reinterpret_cast<io_uring_buf *>(buf_ring_)[buf_tail_ & (kBufferCount - 1)];
+    buf.addr          = reinterpret_cast<uint64_t>(buffers_ + bid * kBufferSize);
+    buf.len           = kBufferSize;
+    buf.bid           = static_cast<uint16_t>(bid);
+    __atomic_store_n(&buf_ring_->tail, ++buf_tail_, __ATOMIC_RELEASE);
+}
+
+bool IoUringBackend::installFile(int index, int fd) {
+    io_uring_files_update update{};
+    update.offset = static_cast<uint32_t>(index);
+    update.fds    = reinterpret_cast<uint64_t>(&fd);
+    return sysRegister(ring_fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+}
+
+void IoUringBackend::openConnection(int fd, const TcpServer::OnConnection &on_connection) {
+    if (static_cast<size_t>(fd) >= connections_.size()) {
+        connections_.resize(fd + 1);
+    }
+    Connection &conn = connections_[fd];
+    conn             = Connection{};
+    conn.open        = true;
+    conn.fixed       = static_cast<unsigned>(fd) < max_files_ && installFile(fd, fd);
+    LOG_INFO << "New client connected: " << fd;
+    armRecv(fd);
+    if (on_connection) {
+        on_connection(fd);
+    }
+}
+
+void IoUringBackend::closeConnection(int fd, const TcpServer::OnDisconnection &on_disconnection) {
+    Connection &conn = connections_[fd];
+    if (!conn.open) {
+        return;
+    }
+    if (on_disconnection) {
+        on_disconnection(fd);
+    }
+    conn.open = false;
+    conn.pending.clear();
+    publish(fd);
+    if (conn.sending) {
+        conn.closing = true; // Keep the fd and its buffer until the kernel is done with them
+        return;
+    }
+    releaseConnection(fd);
+}
+
+void IoUringBackend::releaseConnection(int fd) {
+    Connection &conn = connections_[fd];
+    if (conn.fixed) {
+        installFile(fd, -1);
+    }
+    conn = Connection{};
+    publish(fd);
+    close(fd);
+}
+
+void IoUringBackend::publish(int fd) {
+    if (static_cast<size_t>(fd) < mirror_size_) {
+        mirror_[fd].store(queued(fd), std::memory_order_relaxed);
+    }
+}
+
+#else // Headers too old for multishot operations: always fall back to epoll
+
+std::unique_ptr<IoUringBackend> IoUringBackend::create(int, int) {
+    LOG_WARN << "Built without io_uring multishot support";
+    return nullptr;
+}
+
+IoUringBackend::~IoUringBackend() = default;
+
+void IoUringBackend::poll(int, const TcpServer::OnConnection &, const TcpServer::OnMessage &,
+                          const TcpServer::OnDisconnection &) {
+}
+
+size_t IoUringBackend::send(int, const char *, size_t) {
+    return 0;
+}
+
+void IoUringBackend::discard(int) {
+}
+
+#endif
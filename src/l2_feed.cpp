@@ -0,0 +1,151 @@
+#include <l2_feed.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+class L2Feed::Encoder {
+  public:
+    Encoder(const WireSymbol &wire_symbol, const Instrument &inst, std::vector<char> &out)
+        : wire_symbol_(wire_symbol), inst_(inst), out_(out) {
+    }
+
+    // Start a message; levels go into it until it is full or the next begin()
+    void begin(uint64_t seq, uint8_t flags) {
+        start_ = out_.size();
+        out_.resize(start_ + offsetof(MarketDataUpdate, levels));
+        MarketDataUpdate *msg = message();
+        msg->header     = {0, MessageType::MARKET_DATA_UPDATE, offsetof(MarketDataUpdate, levels)};
+        std::memcpy(msg->symbol, wire_symbol_, sizeof(WireSymbol));
+        msg->seq_num    = seq;
+        msg->flags      = flags;
+        msg->num_levels = 0;
+    }
+
+    bool full() const {
+        return message()->num_levels == MarketDataUpdate::kMaxLevels;
+    }
+
+    void add(OrderSide side, Price price, Quantity quantity, LevelUpdate::Action action) {
+        L2Delta delta;
+        delta.price    = inst_.to_price(price);
+        delta.quantity = quantity;
+        delta.side     = side == OrderSide::BUY ? 0 : 1;
+        delta.action   = static_cast<uint8_t>(action);
+        size_t at      = out_.size();
+        out_.resize(at + sizeof(L2Delta));
+        std::memcpy(out_.data() + at, &delta, sizeof(delta));
+        MarketDataUpdate *msg = message();
+        ++msg->num_levels;
+        msg->header.msg_len += sizeof(L2Delta);
+    }
+
+    void set_flags(uint8_t flags) {
+        message()->flags |= flags;
+    }
+
+  private:
+    MarketDataUpdate *message() const {
+        return reinterpret_cast<MarketDataUpdate *>(out_.data() + start_);
+    }
+
+    const WireSymbol &wire_symbol_;
+    const Instrument &inst_;
+    std::vector<char> &out_;
+    size_t start_ = 0;
+};
+
+Quantity L2Feed::Book::quantity(OrderSide side, Price price) const {
+    if (side == OrderSide::BUY) {
+        auto it = bids.find(price);
+        return it == bids.end() ? 0 : it->second;
+    }
+    auto it = asks.find(price);
+    return it == asks.end() ? 0 : it->second;
+}
+
+L2Feed::Book &L2Feed::book(SymbolId symbol) {
+    if (symbol >= books_.size()) {
+        books_.resize(symbol + 1);
+    }
+    return books_[symbol];
+}
+
+void L2Feed::set_ready(SymbolId symbol) {
+    book(symbol).ready = true;
+}
+
+void L2Feed::apply(SymbolId symbol, const LevelUpdate &update) {
+    Book &b = book(symbol);
+    if (b.ready) {
+        b.changes.push_back({update.side, update.price, b.quantity(update.side, update.price)});
+    }
+    auto set = [&](auto &levels) {
+        if (update.action == LevelUpdate::Action::DELETE || update.quantity == 0) {
+            levels.erase(update.price);
+        } else {
+            levels[update.price] = update.quantity;
+        }
+    };
+    if (update.side == OrderSide::BUY) {
+        set(b.bids);
+    } else {
+        set(b.asks);
+    }
+}
+
+size_t L2Feed::encode_updates(SymbolId symbol, const WireSymbol &wire_symbol,
+                              const Instrument &inst, std::vector<char> &out) {
+    if (symbol >= books_.size() || books_[symbol].changes.empty()) {
+        return 0;
+    }
+    Book &b = books_[symbol];
+    // Group by level; stable, so the first entry of each holds the total before any change
+    std::stable_sort(b.changes.begin(), b.changes.end(), [](const Change &x, const Change &y) {
+        return x.side != y.side ? x.side < y.side : x.price < y.price;
+    });
+    Encoder encoder(wire_symbol, inst, out);
+    size_t messages = 0;
+    for (size_t i = 0; i < b.changes.size(); ++i) {
+        const Change &change = b.changes[i];
+        if (i > 0 && change.side == b.changes[i - 1].side &&
+            change.price == b.changes[i - 1].price) {
+            continue;
+        }
+        Quantity after = b.quantity(change.side, change.price);
+        if (after == change.before) {
+            continue; // Back where it started
+        }
+        LevelUpdate::Action action = change.before == 0 ? LevelUpdate::Action::ADD
+                                     : after == 0       ? LevelUpdate::Action::DELETE
+                                                        : LevelUpdate::Action::CHANGE;
+        if (messages == 0 || encoder.full()) {
+            encoder.begin(++b.seq, 0);
+            ++messages;
+        }
+        encoder.add(change.side, change.price, after, action);
+    }
+    b.changes.clear();
+    return messages;
+}
+
+void L2Feed::encode_snapshot(SymbolId symbol, const WireSymbol &wire_symbol,
+                             const Instrument &inst, std::vector<char> &out) const {
+    static const Book kEmpty;
+    const Book &b = symbol < books_.size() ? books_[symbol] : kEmpty;
+    Encoder encoder(wire_symbol, inst, out);
+    encoder.begin(b.seq, MarketDataUpdate::kSnapshotBegin);
+    auto add = [&](OrderSide side, Price price, Quantity quantity) {
+        if (encoder.full()) {
+            encoder.begin(b.seq, 0);
+        }
+        encoder.add(side, price, quantity, LevelUpdate::Action::ADD);
+    };
+    for (const auto &[price, quantity] : b.bids) {
+        add(OrderSide::BUY, price, quantity);
+    }
+    for (const auto &[price, quantity] : b.asks) {
+        add(OrderSide::SELL, price, quantity);
+    }
+    encoder.set_flags(MarketDataUpdate::kSnapshotEnd);
+}
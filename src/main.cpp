@@ -1,11 +1,14 @@
 #include "../logging/logger.hpp"
+#include <algorithm>
 #include <chrono>
 #include <client_gateway.h>
 #include <config.h>
 #include <iostream>
 #include <matching_engine.h>
+#include <memory>
 #include <order.h>
 #include <protocol.h>
+#include <sharded_engine.h>
 #include <tcp_server.h>
 
 
@@ -15,9 +18,32 @@ int main(int argc, char *argv[]) {
 
     LOG_INFO << "Starting Matching Engine on port " << Config::getInstance().port;
 
-    MatchingEngine engine;
-    TcpServer server(Config::getInstance().port);
-    ClientGateway gateway(engine, server);
+    const Config &config = Config::getInstance();
+    const bool sharded   = config.shards > 0 || config.pipeline;
+
+    // Sharded, this engine only keeps the symbol table and each shard spills its own trades
+    MatchingEngine engine(sharded ? std::string() : config.trade_spill_path);
+    engine.instruments().setDefault(
+        Instrument::fromTickSize("", Config::getInstance().default_tick_size));
+    for (const auto &[symbol, tick] : Config::getInstance().instrument_ticks) {
+        engine.instruments().add(Instrument::fromTickSize(symbol, tick));
+    }
+    TcpServer server(Config::getInstance().port, Config::getInstance().busy_poll,
+                     Config::getInstance().idle_timeout_us,
+                     Config::getInstance().io_backend == "io_uring" ? TcpServer::Backend::IO_URING
+                                                                    : TcpServer::Backend::EPOLL);
+    server.setSendHighWater(Config::getInstance().send_high_water);
+    server.setSendLimit(Config::getInstance().send_limit);
+
+    // Sharded mode: matching runs on its own threads, the engine above keeps the symbol table.
+    // Pipeline mode is sharded mode with at least one shard plus an egress thread.
+    std::unique_ptr<ShardedEngine> shards;
+    if (sharded) {
+        shards = std::make_unique<ShardedEngine>(std::max<size_t>(config.shards, 1),
+                                                 config.shard_queue_depth,
+                                                 config.trade_spill_path);
+    }
+    ClientGateway gateway(engine, server, shards.get(), config.pipeline);
 
     if (Config::getInstance().replay_mode) {
         LOG_INFO << "Starting in replay mode";
@@ -1,120 +1,302 @@
 #include <../logging/logger.hpp>
+#include <algorithm>
 #include <chrono>
+#include <config.h>
 #include <iostream>
 #include <matching_engine.h>
 #include <optional>
 #include <string>
 
 std::vector<Trade> MatchingEngine::process_new_order(const Order &incoming_order) {
-    Order *order_ptr = order_pool_.allocate();
-    if (!order_ptr) {
-        LOG_ERROR << "Order pool exhausted. Cannot process new order ID: " << incoming_order.id;
-        return {};
-    }
-    *order_ptr = incoming_order;
-
     std::vector<Trade> trades;
+    process_new_order(incoming_order, [&trades](const Trade &trade) { trades.push_back(trade); });
+    return trades;
+}
+
+OrderResult MatchingEngine::process_new_order(const Order &incoming_order, TradeSink on_trade) {
     // 1. Validate the order
-    if (!validate_order(*order_ptr)) {
+    if (!validate_order(incoming_order)) {
         LOG_ERROR << "Order ID: " << incoming_order.id << " failed validation.";
-        order_pool_.deallocate(order_ptr); // Deallocate the order if validation fails
-        return trades;                     // Return empty trade list on invalid order
+        return {OrderOutcome::REJECTED, 0}; // No trades on an invalid order
     }
+
     // 2. Get or create the order book for the symbol
-    OrderBook &book = get_or_create_order_book(incoming_order.symbol);
+    OrderBook &book    = get_or_create_order_book(incoming_order.symbol);
+    OrderResult result = execute_order(book, incoming_order, on_trade);
+    book.publish();
+    return result;
+}
 
-    // Check for sufficient liquidity for IOC and FOK orders
-    if (order_ptr->type == OrderType::FOK && !can_fill_completely(book, *order_ptr)) {
+size_t MatchingEngine::process_orders(std::span<const Order> orders, TradeSink on_trade) {
+    // Group the valid orders by symbol with a counting sort over the dense symbol ids.
+    // It is stable, so each book sees its orders in arrival order.
+    batch_valid_.clear();
+    batch_offsets_.assign(symbols_.size() + 1, 0);
+    for (size_t i = 0; i < orders.size(); ++i) {
+        if (validate_order(orders[i])) {
+            batch_valid_.push_back(static_cast<uint32_t>(i));
+            ++batch_offsets_[orders[i].symbol + 1];
+        } else {
+            LOG_ERROR << "Order ID: " << orders[i].id << " failed validation.";
+        }
+    }
+    for (size_t s = 1; s < batch_offsets_.size(); ++s) {
+        batch_offsets_[s] += batch_offsets_[s - 1];
+    }
+    batch_order_.resize(batch_valid_.size());
+    for (uint32_t i : batch_valid_) {
+        batch_order_[batch_offsets_[orders[i].symbol]++] = i;
+    }
+
+    size_t trade_count = 0;
+    for (size_t group = 0; group < batch_order_.size();) {
+        SymbolId symbol = orders[batch_order_[group]].symbol;
+        OrderBook &book = get_or_create_order_book(symbol);
+        size_t end      = group;
+        while (end < batch_order_.size() && orders[batch_order_[end]].symbol == symbol) {
+            ++end;
+        }
+        for (size_t i = group; i < end; ++i) {
+            if (i + 1 < end) {
+                const Order &next = orders[batch_order_[i + 1]];
+                book.prefetch(next.id, next.side, next.price);
+            }
+            trade_count += execute_order(book, orders[batch_order_[i]], on_trade).trades;
+            order_pool_.prefetch_next();
+        }
+        book.publish(); // Once per book, not per order
+        group = end;
+    }
+    return trade_count;
+}
+
+OrderResult MatchingEngine::execute_order(OrderBook &book, const Order &incoming_order,
+                                          TradeSink on_trade) {
+    const bool buy     = incoming_order.side == OrderSide::BUY;
+    const bool auction = book.phase() == OrderBook::Phase::AUCTION;
+    if (auction && incoming_order.type != OrderType::LIMIT &&
+        incoming_order.type != OrderType::GFD) {
+        LOG_INFO << "Order ID: " << incoming_order.id
+                 << " needs immediate execution during an auction. Rejecting.";
+        return {OrderOutcome::REJECTED, 0};
+    }
+    // Check for sufficient liquidity for FOK orders before taking a pool slot, noting
+    // where the sweep will end
+    FokBound fok_bound;
+    if (incoming_order.type == OrderType::FOK &&
+        !(buy ? can_fill_completely<OrderSide::BUY>(book, incoming_order.price,
+                                                    incoming_order.quantity, fok_bound)
+              : can_fill_completely<OrderSide::SELL>(book, incoming_order.price,
+                                                     incoming_order.quantity, fok_bound))) {
         LOG_INFO << "Order ID: " << incoming_order.id << " cannot be fully filled. Cancelling.";
-        return trades;
+        return {OrderOutcome::KILLED, 0};
     }
 
-    // 3. Match the order against existing orders
-    if (order_ptr->side == OrderSide::BUY) {
-        trades = match_against_sell_orders(book, order_ptr);
-    } else {
-        trades = match_against_buy_orders(book, order_ptr);
+    RestingOrder *order_ptr = allocate_order(incoming_order);
+    if (!order_ptr) {
+        LOG_ERROR << "Order pool at its limit of " << order_pool_.max_capacity()
+                  << " orders. Rejecting new order ID: " << incoming_order.id;
+        return {OrderOutcome::REJECTED, 0};
+    }
+
+    // Auction phase: collect the order for the uncross without matching
+    if (auction) {
+        book.add_order(order_ptr);
+        link_user_order(order_ptr->slot);
+        stats_.total_orders++;
+        return {};
     }
+
+    // 3. Match against the book and rest or release the remainder, in the
+    // instantiation for this side and type (GFD rests like LIMIT)
+    size_t trade_count;
+    switch (incoming_order.type) {
+    case OrderType::MARKET:
+        trade_count = buy ? execute<OrderSide::BUY, OrderType::MARKET>(book, order_ptr, on_trade)
+                          : execute<OrderSide::SELL, OrderType::MARKET>(book, order_ptr, on_trade);
+        break;
+    case OrderType::IOC:
+        trade_count = buy ? execute<OrderSide::BUY, OrderType::IOC>(book, order_ptr, on_trade)
+                          : execute<OrderSide::SELL, OrderType::IOC>(book, order_ptr, on_trade);
+        break;
+    case OrderType::FOK:
+        trade_count = buy ? sweep_fok<OrderSide::BUY>(book, order_ptr, fok_bound, on_trade)
+                          : sweep_fok<OrderSide::SELL>(book, order_ptr, fok_bound, on_trade);
+        release_order(order_ptr); // Always filled completely
+        break;
+    default:
+        trade_count = buy ? execute<OrderSide::BUY, OrderType::LIMIT>(book, order_ptr, on_trade)
+                          : execute<OrderSide::SELL, OrderType::LIMIT>(book, order_ptr, on_trade);
+        break;
+    }
+    return {OrderOutcome::ACCEPTED, trade_count};
+}
+
+template <OrderSide S, OrderType T>
+size_t MatchingEngine::execute(OrderBook &book, RestingOrder *taker, TradeSink on_trade) {
+    size_t trade_count = match<S, T>(book, taker, on_trade);
+
     // 4. Add the order to the book if not fully filled
-    if (!order_ptr->is_filled()) {
-        if (order_ptr->type == OrderType::IOC) {
-            LOG_INFO << "Order ID: " << incoming_order.id
+    if constexpr (T == OrderType::LIMIT) {
+        if (!taker->is_filled()) {
+            book.add_order(taker);
+            link_user_order(taker->slot);
+            stats_.total_orders++;
+            return trade_count;
+        }
+    } else if constexpr (T == OrderType::IOC) {
+        if (!taker->is_filled()) {
+            LOG_INFO << "Order ID: " << taker->id
                      << " is IOC and not fully filled. Cancelling remaining quantity.";
-            order_pool_.deallocate(order_ptr); // Deallocate the unfilled IOC order
-            return trades;
         }
-        if (order_ptr->type != OrderType::MARKET) {
-            book.add_order(order_ptr);
-            stats_.total_orders++;
+    }
+    release_order(taker); // Deallocate if fully filled or not allowed to rest
+    // 5. Return the number of trades executed
+    return trade_count;
+}
+
+template <OrderSide S, OrderType T>
+size_t MatchingEngine::match(OrderBook &book, RestingOrder *taker, TradeSink on_trade) {
+    constexpr OrderSide kMakerSide = opposite(S);
+    PriceLadder<kMakerSide> &makers = book.ladder<kMakerSide>();
+    size_t trade_count              = 0;
+
+    while (taker->remaining_qty() > 0 && !makers.empty()) {
+        RestingOrder *maker = makers.best_order();
+        if constexpr (T != OrderType::MARKET) { // MARKET has no limit
+            if (PriceLadder<kMakerSide>::better(taker->price, maker->price)) {
+                break; // Best maker is beyond the taker's limit
+            }
         }
-    } else {
-        order_pool_.deallocate(order_ptr); // Deallocate if fully filled or a market order
+        fill<S>(book, taker, maker, std::min(taker->remaining_qty(), maker->remaining_qty()),
+                on_trade);
+        ++trade_count;
     }
-    // 5. Return the list of trades executed
+    return trade_count;
+}
 
-    return trades;
+template <OrderSide S>
+size_t MatchingEngine::sweep_fok(OrderBook &book, RestingOrder *taker, FokBound bound,
+                                 TradeSink on_trade) {
+    PriceLadder<opposite(S)> &makers = book.ladder<opposite(S)>();
+    size_t trade_count               = 0;
+    // Every maker before the bound level fills completely, with no limit or size check
+    while (makers.best() != bound.last_price) {
+        RestingOrder *maker = makers.best_order();
+        fill<S>(book, taker, maker, maker->remaining_qty(), on_trade);
+        ++trade_count;
+    }
+    // The bound level, in time priority until the taker is done
+    for (Quantity left = bound.last_qty; left > 0; ++trade_count) {
+        RestingOrder *maker = makers.best_order();
+        Quantity trade_qty  = std::min(left, maker->remaining_qty());
+        fill<S>(book, taker, maker, trade_qty, on_trade);
+        left -= trade_qty;
+    }
+    return trade_count;
 }
 
-std::vector<Trade> MatchingEngine::match_against_buy_orders(OrderBook &book, Order *sell_order) {
-    std::vector<Trade> trades;
+template <OrderSide S>
+void MatchingEngine::fill(OrderBook &book, RestingOrder *taker, RestingOrder *maker,
+                          Quantity qty, TradeSink on_trade) {
+    // Trades always execute at the resting order's price
+    if constexpr (S == OrderSide::BUY) {
+        on_trade(create_trade(taker, maker, qty, maker->price));
+    } else {
+        on_trade(create_trade(maker, taker, qty, maker->price));
+    }
+    // Update order quantities; the book unlinks fully filled orders
+    taker->reduce_quantity(qty);
+    book.fill_order<opposite(S)>(maker, qty);
+    if (maker->is_filled()) {
+        release_order(maker); // Deallocate the fully filled resting order
+    }
+}
 
-    while (sell_order->remaining_qty() > 0) {
-        Order *best_bid = book.getBestBid();
-        if (!best_bid ||
-            (best_bid->price < sell_order->price && sell_order->type != OrderType::MARKET)) {
-            break; // No more matching possible
-        }
-        Quantity trade_qty = std::min(sell_order->remaining_qty(), best_bid->remaining_qty());
-        Price trade_price  = best_bid->price;
-        Trade trade        = create_trade(best_bid, sell_order, trade_qty, trade_price);
-        trades.push_back(trade);
-        // Update order quantities
-        sell_order->reduce_quantity(trade_qty);
-        best_bid->reduce_quantity(trade_qty);
-        // Remove fully filled orders from the book
-        if (best_bid->is_filled()) {
-            book.cancel_order(best_bid->id);
-            order_pool_.deallocate(best_bid); // Deallocate the fully filled bid order
-        }
+RestingOrder *MatchingEngine::allocate_order(const Order &order) {
+    uint32_t slot;
+    RestingOrder *ptr = order_pool_.allocate(slot);
+    if (!ptr) {
+        return nullptr;
     }
-    return trades;
+    if (slot >= order_meta_.size()) {
+        order_meta_.resize(order_pool_.capacity()); // The pool grew by a slab
+    }
+    *ptr = RestingOrder{.id              = order.id,
+                        .price           = order.price,
+                        .quantity        = order.quantity,
+                        .quantity_filled = order.quantity_filled,
+                        .slot            = slot,
+                        .side            = order.side,
+                        .status          = order.status};
+    order_meta_[slot] = OrderMeta{.user_id   = order.user_id,
+                                  .session   = order.session,
+                                  .timestamp = order.timestamp,
+                                  .symbol    = order.symbol,
+                                  .type      = order.type};
+    return ptr;
 }
 
-std::vector<Trade> MatchingEngine::match_against_sell_orders(OrderBook &book, Order *buy_order) {
-    std::vector<Trade> trades;
+void MatchingEngine::release_order(RestingOrder *order) {
+    if (order_meta_[order->slot].in_user_list) {
+        unlink_user_order(order->slot);
+    }
+    order_pool_.deallocate(order, order->slot);
+}
 
-    while (buy_order->remaining_qty() > 0) {
-        Order *best_ask = book.getBestAsk();
-        if (!best_ask ||
-            (best_ask->price > buy_order->price && buy_order->type != OrderType::MARKET)) {
-            break; // No more matching possible
-        }
-        LOG_DEBUG << best_ask->id;
-        Quantity trade_qty = std::min(buy_order->remaining_qty(), best_ask->remaining_qty());
-
-        Price trade_price = best_ask->price;
-        Trade trade       = create_trade(buy_order, best_ask, trade_qty, trade_price);
-        trades.push_back(trade);
-        LOG_DEBUG << trade_qty;
-        // Update order quantities
-        buy_order->reduce_quantity(trade_qty);
-        best_ask->reduce_quantity(trade_qty);
-        // Remove fully filled orders from the book
-        if (best_ask->is_filled()) {
-            book.cancel_order(best_ask->id);
-            order_pool_.deallocate(best_ask); // Deallocate the fully filled ask order
-        }
+void MatchingEngine::link_user_order(uint32_t slot) {
+    OrderMeta &meta = order_meta_[slot];
+    uint32_t *head  = user_orders_.find(meta.user_id);
+    meta.user_prev  = kNoSlot;
+    meta.user_next  = head ? *head : kNoSlot;
+    if (head) {
+        order_meta_[*head].user_prev = slot;
+        *head                        = slot;
+    } else {
+        user_orders_.insert_or_assign(meta.user_id, slot);
     }
-    return trades;
+    meta.in_user_list = true;
+}
+
+void MatchingEngine::unlink_user_order(uint32_t slot) {
+    OrderMeta &meta = order_meta_[slot];
+    if (meta.user_next != kNoSlot) {
+        order_meta_[meta.user_next].user_prev = meta.user_prev;
+    }
+    if (meta.user_prev != kNoSlot) {
+        order_meta_[meta.user_prev].user_next = meta.user_next;
+    } else if (meta.user_next != kNoSlot) {
+        *user_orders_.find(meta.user_id) = meta.user_next; // New head
+    } else {
+        user_orders_.erase(meta.user_id); // Last resting order of the user
+    }
+    meta.in_user_list = false;
 }
 
-Trade MatchingEngine::create_trade(Order *buy_order, Order *sell_order, Quantity trade_quantity,
-                                   Price trade_price) {
+Order MatchingEngine::to_order(const RestingOrder &order) const {
+    const OrderMeta &meta = order_meta_[order.slot];
+    return Order{.id              = order.id,
+                 .symbol          = meta.symbol,
+                 .user_id         = meta.user_id,
+                 .session         = meta.session,
+                 .side            = order.side,
+                 .type            = meta.type,
+                 .price           = order.price,
+                 .quantity        = order.quantity,
+                 .quantity_filled = order.quantity_filled,
+                 .status          = order.status,
+                 .timestamp       = meta.timestamp};
+}
+
+Trade MatchingEngine::create_trade(RestingOrder *buy_order, RestingOrder *sell_order,
+                                   Quantity trade_quantity, Price trade_price) {
+    const OrderMeta &buy_meta  = order_meta_[buy_order->slot];
+    const OrderMeta &sell_meta = order_meta_[sell_order->slot];
     Trade trade{.buy_order_id  = buy_order->id,
-                .buy_user_id   = buy_order->user_id,
+                .buy_user_id   = buy_meta.user_id,
                 .sell_order_id = sell_order->id,
-                .sell_user_id  = sell_order->user_id,
-                .symbol        = buy_order->symbol,
+                .sell_user_id  = sell_meta.user_id,
+                .symbol        = buy_meta.symbol,
                 .price         = trade_price,
                 .quantity      = trade_quantity,
                 .timestamp     = std::chrono::system_clock::now().time_since_epoch().count()};
@@ -122,9 +304,9 @@ Trade MatchingEngine::create_trade(Order *buy_order, Order *sell_order, Quantity
     stats_.total_trades++;
     stats_.total_volume += trade_quantity;
     // Add to trade history
-    trade_history_.push_back(trade);
+    trade.sequence = trade_history_.append(trade);
     LOG_DEBUG << "Trade executed: " << trade.quantity << "@" << trade.price << " symbol "
-              << trade.symbol << " buy:" << trade.buy_order_id << " sell:" << trade.sell_order_id;
+              << symbols_.name(trade.symbol) << " buy:" << trade.buy_order_id << " sell:" << trade.sell_order_id;
     return trade;
 }
 
@@ -134,81 +316,232 @@ bool MatchingEngine::validate_order(const Order &order) {
         LOG_ERROR << "Invalid order quantity: 0 for order ID: " << order.id;
         return false;
     }
-    if (order.symbol.empty()) {
-        LOG_ERROR << "Invalid order symbol: empty for order ID: " << order.id;
+    if (order.symbol >= symbols_.size()) {
+        LOG_ERROR << "Invalid order symbol: unknown for order ID: " << order.id;
         return false;
     }
-    if (order.type == OrderType::LIMIT && order.price <= 0.0) {
+    if (order.type == OrderType::LIMIT && order.price <= 0) {
         LOG_ERROR << "Invalid limit order price: " << order.price << " for order ID: " << order.id;
         return false;
     }
-    if (order.price < 0.0) {
+    if (order.price < 0) {
         LOG_ERROR << "Invalid order price: " << order.price << " for order ID: " << order.id;
         return false;
     }
     return true;
 }
 
-bool MatchingEngine::can_fill_completely(const OrderBook &book, const Order &order) {
-    Quantity needed_qty = order.quantity;
-    auto &map           = (order.side == OrderSide::BUY) ? book.sell_orders_ : book.buy_orders_;
-    if (OrderSide::BUY == order.side) {
-        for (const auto &[price, orders_at_price] : map) {
-            if (price > order.price) {
-                break; // No more matching possible
-            }
-            for (const auto &o : orders_at_price) {
-                needed_qty -= o->remaining_qty();
-                if (needed_qty <= 0) {
-                    return true; // Sufficient liquidity found
-                }
-            }
+template <OrderSide S>
+bool MatchingEngine::can_fill_completely(const OrderBook &book, Price price, Quantity quantity,
+                                         FokBound &bound) const {
+    constexpr OrderSide kMakerSide        = opposite(S);
+    const PriceLadder<kMakerSide> &makers = book.ladder<kMakerSide>();
+    if (makers.total_qty() < quantity) {
+        return false; // Not enough on the whole side, whatever the prices
+    }
+    Quantity needed_qty = quantity;
+    bool enough         = false;
+    // Walk the opposite side's level aggregates from the touch until the limit price is
+    // passed; individual orders are never visited
+    makers.for_each_level([&](Price level_price, const LevelQueue &level) {
+        if (PriceLadder<kMakerSide>::better(price, level_price)) {
+            return false; // No more matching possible
         }
-    } else {
-        for (const auto &[price, orders_at_price] : map) {
-            if (price < order.price) {
-                break; // No more matching possible
-            }
-            for (const auto &o : orders_at_price) {
-                needed_qty -= o->remaining_qty();
-                if (needed_qty <= 0) {
-                    return true; // Sufficient liquidity found
-                }
-            }
+        if (level.total_qty >= needed_qty) {
+            enough = true; // Sufficient liquidity found; the sweep stops in this level
+            bound  = FokBound{level_price, needed_qty};
+            return false;
         }
+        needed_qty -= level.total_qty;
+        return true;
+    });
+    return enough; // Not enough liquidity unless the scan found it
+}
+
+OrderBook &MatchingEngine::get_or_create_order_book(SymbolId symbol) {
+    if (symbol >= order_books_.size()) {
+        order_books_.resize(symbols_.size());
+    }
+    auto &book = order_books_[symbol];
+    if (!book) {
+        const Config &config = Config::getInstance();
+        book = std::make_unique<OrderBook>(symbols_.name(symbol), config.book_window_ticks,
+                                           config.order_index_capacity);
+        published_books_[symbol].store(book.get(), std::memory_order_release);
     }
-    return false; // Not enough liquidity
+    return *book;
 }
 
-OrderBook &MatchingEngine::get_or_create_order_book(const Symbol &symbol) {
-    auto it = order_books_.find(symbol);
-    if (it != order_books_.end()) {
-        return it->second;
+OrderBook *MatchingEngine::get_order_book(SymbolId symbol) {
+    if (symbol >= order_books_.size()) {
+        return nullptr;
     }
-    it = order_books_.emplace(symbol, OrderBook(symbol)).first;
-    return it->second;
+    return order_books_[symbol].get();
+}
+
+OrderBook &MatchingEngine::get_or_create_order_book(const Symbol &symbol) {
+    return get_or_create_order_book(symbols_.intern(symbol));
 }
 
 OrderBook *MatchingEngine::get_order_book(const Symbol &symbol) {
-    auto it = order_books_.find(symbol);
-    if (it != order_books_.end()) {
-        return &it->second;
-    }
-    return nullptr;
+    SymbolId id = symbols_.find(symbol);
+    return id == kInvalidSymbol ? nullptr : get_order_book(id);
 }
 
-std::optional<Order> MatchingEngine::cancel_order(const OrderID &id, const Symbol &symbol,
-                                                  int side) {
-    auto &book = get_or_create_order_book(symbol);
-    Order *ptr = book.cancel_order(id);
+std::optional<Order> MatchingEngine::cancel_order(const OrderID &id, SymbolId symbol, int side) {
+    OrderBook *book   = get_order_book(symbol);
+    RestingOrder *ptr = book ? book->cancel_order(id) : nullptr;
     if (ptr) {
-        Order cancelled_data = *ptr; // Copy data before deallocation
-        order_pool_.deallocate(ptr);
+        Order cancelled_data = to_order(*ptr); // Copy data before deallocation
+        release_order(ptr);
+        book->publish();
         return cancelled_data;
     }
     return std::nullopt; // Order not found
 }
 
+std::optional<Order> MatchingEngine::modify_order(const OrderID &id, SymbolId symbol, Price price,
+                                                  Quantity quantity, TradeSink on_trade) {
+    OrderBook *book     = get_order_book(symbol);
+    RestingOrder *order = book ? book->getOrderbyId(id) : nullptr;
+    if (!order) {
+        LOG_WARN << "Attempted to replace non-existent order ID: " << id;
+        return std::nullopt;
+    }
+    if (price <= 0) {
+        LOG_ERROR << "Invalid replace price: " << price << " for order ID: " << id;
+        return std::nullopt;
+    }
+
+    // Nothing left to work: the replace amounts to a cancel
+    if (quantity <= order->quantity_filled) {
+        book->cancel_order(id);
+        Order cancelled  = to_order(*order);
+        cancelled.status = OrderStatus::CANCELLED;
+        release_order(order);
+        book->publish();
+        return cancelled;
+    }
+
+    // Size-down at the same price keeps the order's place in the queue
+    if (price == order->price && quantity <= order->quantity) {
+        book->reduce_order(order, quantity);
+        book->publish();
+        return to_order(*order);
+    }
+
+    // Reprice or size-up: off its level, through the kernel as a limit taker, and
+    // back in at the end of the new level with whatever is left
+    book->detach_order(order);
+    order->price    = price;
+    order->quantity = quantity;
+    if (book->phase() == OrderBook::Phase::AUCTION) {
+        // No matching until the uncross
+    } else if (order->side == OrderSide::BUY) {
+        match<OrderSide::BUY, OrderType::LIMIT>(*book, order, on_trade);
+    } else {
+        match<OrderSide::SELL, OrderType::LIMIT>(*book, order, on_trade);
+    }
+    Order replaced = to_order(*order);
+    if (order->is_filled()) {
+        book->forget_order(id);
+        release_order(order);
+    } else {
+        book->reattach_order(order);
+    }
+    book->publish();
+    return replaced;
+}
+
+void MatchingEngine::begin_auction(SymbolId symbol) {
+    get_or_create_order_book(symbol).set_phase(OrderBook::Phase::AUCTION);
+    LOG_INFO << "Auction started for " << symbols_.name(symbol);
+}
+
+size_t MatchingEngine::uncross(SymbolId symbol, TradeSink on_trade) {
+    OrderBook *book = get_order_book(symbol);
+    if (!book) {
+        return 0;
+    }
+    book->set_phase(OrderBook::Phase::CONTINUOUS);
+    OrderBook::Uncross cross = book->find_uncross();
+
+    // Every bid at or above the price and every ask at or below it is eligible, and the
+    // equilibrium volume never exceeds either, so pairing the best of each side fills
+    // exactly that volume
+    size_t trade_count = 0;
+    for (Quantity left = cross.volume; left > 0;) {
+        RestingOrder *bid = book->getBestBid();
+        RestingOrder *ask = book->getBestAsk();
+        Quantity qty      = std::min({left, bid->remaining_qty(), ask->remaining_qty()});
+        on_trade(create_trade(bid, ask, qty, cross.price));
+        ++trade_count;
+        left -= qty;
+        book->fill_order<OrderSide::BUY>(bid, qty);
+        book->fill_order<OrderSide::SELL>(ask, qty);
+        if (bid->is_filled()) {
+            release_order(bid);
+        }
+        if (ask->is_filled()) {
+            release_order(ask);
+        }
+    }
+    book->publish();
+    LOG_INFO << "Uncrossed " << symbols_.name(symbol) << ": " << cross.volume << "@"
+             << cross.price << " in " << trade_count << " trades";
+    return trade_count;
+}
+
+std::vector<Order> MatchingEngine::mass_cancel(UserID user_id, SymbolId symbol,
+                                               uint32_t session) {
+    std::vector<Order> cancelled;
+    const uint32_t *head = user_orders_.find(user_id);
+    for (uint32_t slot = head ? *head : kNoSlot; slot != kNoSlot;) {
+        const OrderMeta &meta = order_meta_[slot];
+        uint32_t next         = meta.user_next; // Read before the slot is released
+        if ((symbol == kInvalidSymbol || meta.symbol == symbol) &&
+            (session == 0 || meta.session == session)) {
+            RestingOrder &order = order_pool_.at(slot);
+            OrderBook *book     = get_order_book(meta.symbol);
+            book->cancel_order(order.id);
+            cancelled.push_back(to_order(order));
+            release_order(&order);
+        }
+        slot = next;
+    }
+    // Once per book, not per order
+    std::vector<SymbolId> touched;
+    for (const Order &order : cancelled) {
+        touched.push_back(order.symbol);
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (SymbolId s : touched) {
+        get_order_book(s)->publish();
+    }
+    LOG_INFO << "Mass cancel for user " << user_id << " cancelled " << cancelled.size()
+             << " orders";
+    return cancelled;
+}
+
+std::vector<Order> MatchingEngine::cancel_all(SymbolId symbol) {
+    std::vector<Order> cancelled;
+    OrderBook *book = get_order_book(symbol);
+    if (!book) {
+        return cancelled;
+    }
+    cancelled.reserve(book->getTotalOrders());
+    for (auto best : {&OrderBook::getBestBid, &OrderBook::getBestAsk}) {
+        while (RestingOrder *order = (book->*best)()) {
+            book->cancel_order(order->id);
+            cancelled.push_back(to_order(*order));
+            release_order(order);
+        }
+    }
+    book->publish();
+    return cancelled;
+}
+
 void MatchingEngine::printStats() const {
     LOG_INFO << "=== Matching Engine Stats ===";
     LOG_INFO << "Total Orders: " << stats_.total_orders.load();
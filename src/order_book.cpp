@@ -1,57 +1,164 @@
 
 #include "types.h"
+#include <algorithm>
+#include <cstdlib>
 #include <order_book.h>
 
 #include <../logging/logger.hpp>
 
-OrderBook::OrderBook(const Symbol &symbol) : symbol_(symbol) {
+OrderBook::OrderBook(const Symbol &symbol, size_t window_ticks, size_t index_capacity)
+    : symbol_(symbol), buy_orders_(window_ticks), sell_orders_(window_ticks),
+      order_lookup_(index_capacity) {
     LOG_INFO << "OrderBook created for symbol: " << symbol;
 }
 
-void OrderBook::add_order(Order *order) {
+void OrderBook::add_order(RestingOrder *order) {
     LOG_DEBUG << "Adding order ID: " << order->id << " to OrderBook for symbol: " << symbol_;
 
-    auto &price_map = (order->side == OrderSide::BUY) ? buy_orders_ : sell_orders_;
-    auto &orderlist = price_map[order->price];
-
-    orderlist.push_back(order);
-
-    order_lookup_[order->id] = {order, std::prev(orderlist.end())};
-
-    LOG_DEBUG << "Order ID: " << order->id << " added at price: " << order->price
-              << " with position: " << std::distance(orderlist.begin(), std::prev(orderlist.end()));
     // 1. Add order to appropriate book (buy/sell)
+    if (order->side == OrderSide::BUY) {
+        buy_orders_.push_back(order);
+    } else {
+        sell_orders_.push_back(order);
+    }
+    note_level(order, true);
+
     // 2. Update order_lookup_ for quick access
+    order_lookup_.insert_or_assign(order->id, order);
+
+    LOG_DEBUG << "Order ID: " << order->id << " added at price: " << order->price;
 }
 
-Order *OrderBook::cancel_order(const OrderID &order_id) {
-    auto it = order_lookup_.find(order_id);
-    if (it == order_lookup_.end()) {
+RestingOrder *OrderBook::cancel_order(const OrderID &order_id) {
+    RestingOrder **found = order_lookup_.find(order_id);
+    if (!found) {
         LOG_WARN << "Attempted to cancel non-existent order ID: " << order_id;
         return nullptr; // Order not found
     }
-    OrderInfo info    = it->second;
-    auto &price_map   = (info.order_ptr->side == OrderSide::BUY) ? buy_orders_ : sell_orders_;
-    auto orderlist_it = price_map.find(info.order_ptr->price);
-    if (orderlist_it != price_map.end()) {
-        orderlist_it->second.erase(info.list_it);
-        if (orderlist_it->second.empty()) {
-            price_map.erase(orderlist_it);
+    RestingOrder *order = *found;
+    if (order->side == OrderSide::BUY) {
+        buy_orders_.remove(order);
+    } else {
+        sell_orders_.remove(order);
+    }
+    note_level(order);
+    order_lookup_.erase(order_id);
+    LOG_INFO << "Cancelled order ID: " << order_id;
+    return order; // Return pointer to cancelled order
+}
+
+void OrderBook::fill_order(RestingOrder *order, Quantity qty) {
+    if (order->side == OrderSide::BUY) {
+        fill_order<OrderSide::BUY>(order, qty);
+    } else {
+        fill_order<OrderSide::SELL>(order, qty);
+    }
+}
+
+void OrderBook::reduce_order(RestingOrder *order, Quantity new_quantity) {
+    Quantity delta = order->quantity - new_quantity;
+    if (order->side == OrderSide::BUY) {
+        buy_orders_.reduce(order, delta);
+    } else {
+        sell_orders_.reduce(order, delta);
+    }
+    order->quantity = new_quantity;
+    note_level(order);
+}
+
+void OrderBook::detach_order(RestingOrder *order) {
+    if (order->side == OrderSide::BUY) {
+        buy_orders_.remove(order);
+    } else {
+        sell_orders_.remove(order);
+    }
+    note_level(order);
+}
+
+void OrderBook::reattach_order(RestingOrder *order) {
+    if (order->side == OrderSide::BUY) {
+        buy_orders_.push_back(order);
+    } else {
+        sell_orders_.push_back(order);
+    }
+    note_level(order, true);
+}
+
+void OrderBook::forget_order(const OrderID &order_id) {
+    order_lookup_.erase(order_id);
+}
+
+OrderBook::Uncross OrderBook::find_uncross() {
+    Uncross best;
+    if (buy_orders_.empty() || sell_orders_.empty() || buy_orders_.best() < sell_orders_.best()) {
+        return best;
+    }
+    // Aggregates of the crossed range: bids at or above the best ask (descending) and
+    // asks at or below the best bid (ascending). The scratch buffers keep their capacity
+    // between uncrosses, so this does not allocate once warmed up.
+    std::vector<std::pair<Price, Quantity>> &bids = uncross_bids_;
+    std::vector<std::pair<Price, Quantity>> &asks = uncross_asks_;
+    bids.clear();
+    asks.clear();
+    Quantity supply = 0;
+    buy_orders_.for_each_level([&](Price price, const LevelQueue &level) {
+        if (price < sell_orders_.best()) {
+            return false;
+        }
+        bids.emplace_back(price, level.total_qty);
+        return true;
+    });
+    sell_orders_.for_each_level([&](Price price, const LevelQueue &level) {
+        if (price > buy_orders_.best()) {
+            return false;
+        }
+        asks.emplace_back(price, level.total_qty);
+        supply += level.total_qty;
+        return true;
+    });
+
+    // Visit candidate prices from high to low. Demand (bids at or above the price) only
+    // grows and supply (asks at or below it) only shrinks along the way.
+    Quantity demand = 0;
+    int64_t best_surplus = 0;
+    Price tied_low       = 0;
+    size_t b             = 0;
+    size_t a             = asks.size();
+    while (b < bids.size() || a > 0) {
+        Price price = std::max(b < bids.size() ? bids[b].first : asks[a - 1].first,
+                               a > 0 ? asks[a - 1].first : bids[b].first);
+        for (; b < bids.size() && bids[b].first >= price; ++b) {
+            demand += bids[b].second;
+        }
+        Quantity volume = std::min(demand, supply);
+        auto surplus    = static_cast<int64_t>(demand) - static_cast<int64_t>(supply);
+        if (volume > best.volume ||
+            (volume == best.volume && volume > 0 && std::abs(surplus) < std::abs(best_surplus))) {
+            best         = Uncross{price, volume};
+            best_surplus = surplus;
+            tied_low     = price;
+        } else if (volume == best.volume && volume > 0 && surplus == best_surplus) {
+            tied_low = price; // Same outcome at a lower price
+        }
+        for (; a > 0 && asks[a - 1].first >= price; --a) {
+            supply -= asks[a - 1].second;
         }
-        order_lookup_.erase(order_id);
-        LOG_INFO << "Cancelled order ID: " << order_id;
-        return info.order_ptr; // Return pointer to cancelled order
     }
-    return nullptr;
+    if (best_surplus < 0) {
+        best.price = tied_low;
+    } else if (best_surplus == 0) {
+        best.price = tied_low + (best.price - tied_low) / 2;
+    }
+    return best;
 }
 
-Order *OrderBook::getOrderbyId(const OrderID &orderid) {
+RestingOrder *OrderBook::getOrderbyId(const OrderID &orderid) {
     // Search the lookup map for the order ID
-    auto it = order_lookup_.find(orderid);
-    
+    RestingOrder **found = order_lookup_.find(orderid);
+
     // If found, return the pointer to the Order
-    if (it != order_lookup_.end()) {
-        return it->second.order_ptr; 
+    if (found) {
+        return *found;
     }
     
     // Log a warning or return nullptr if not found
@@ -59,40 +166,40 @@ Order *OrderBook::getOrderbyId(const OrderID &orderid) {
     return nullptr;
 }
 
-Order *OrderBook::getBestBid() {
+RestingOrder *OrderBook::getBestBid() {
     if (buy_orders_.empty()) {
         return nullptr;
     }
-    return buy_orders_.rbegin()->second.front();
+    return buy_orders_.best_order();
     // Return pointer to best bid order
 }
 
-Order *OrderBook::getBestAsk() {
+RestingOrder *OrderBook::getBestAsk() {
     if (sell_orders_.empty()) {
         return nullptr;
     }
-    return sell_orders_.begin()->second.front();
+    return sell_orders_.best_order();
     // Return pointer to best ask order
 }
 
 Price OrderBook::getSpread() {
     // TODO: Implement this method
     // Return ask - bid (0 if no bids or asks)
-    Order *best_bid = getBestBid();
-    Order *best_ask = getBestAsk();
+    RestingOrder *best_bid = getBestBid();
+    RestingOrder *best_ask = getBestAsk();
     if (best_bid && best_ask) {
         return best_ask->price - best_bid->price;
     }
-    return 0.0;
+    return 0;
 }
 
 L1Quote OrderBook::getL1Quote() {
     L1Quote quote;
-    Order *best_bid = getBestBid();
-    Order *best_ask = getBestAsk();
-    quote.bid       = best_bid ? best_bid->price : 0.0;
+    RestingOrder *best_bid = getBestBid();
+    RestingOrder *best_ask = getBestAsk();
+    quote.bid       = best_bid ? best_bid->price : 0;
     quote.bid_qty   = best_bid ? best_bid->remaining_qty() : 0;
-    quote.ask       = best_ask ? best_ask->price : 0.0;
+    quote.ask       = best_ask ? best_ask->price : 0;
     quote.ask_qty   = best_ask ? best_ask->remaining_qty() : 0;
     return quote;
 }
@@ -101,46 +208,43 @@ L2Quote OrderBook::getL2Quote(size_t depth) const {
     L2Quote quote;
     quote.bids.reserve(depth);
     quote.asks.reserve(depth);
-    // Get top N levels of bids
-    size_t count = 0;
-    for (auto it = buy_orders_.rbegin(); it != buy_orders_.rend() && count < depth; ++it) {
-        Price price        = it->first;
-        Quantity total_qty = 0;
-        for (const auto &order : it->second) {
-            total_qty += order->remaining_qty();
-        }
-        quote.bids.emplace_back(price, total_qty);
-        count++;
+    if (depth == 0) {
+        return quote;
     }
+    // Levels cache their open quantity, so this is O(depth)
+    auto collect = [depth](std::vector<std::pair<Price, Quantity>> &out) {
+        return [&out, depth](Price price, const LevelQueue &level) {
+            out.emplace_back(price, level.total_qty);
+            return out.size() < depth;
+        };
+    };
+    // Get top N levels of bids
+    buy_orders_.for_each_level(collect(quote.bids));
 
     // Get top N levels of asks
-    count = 0;
-    for (auto it = sell_orders_.begin(); it != sell_orders_.end() && count < depth; ++it) {
-        Price price        = it->first;
-        Quantity total_qty = 0;
-        for (const auto &order : it->second) {
-            total_qty += order->remaining_qty();
-        }
-        quote.asks.emplace_back(price, total_qty);
-        count++;
-    }
+    sell_orders_.for_each_level(collect(quote.asks));
 
     return quote;
 }
 
+void OrderBook::getBookTop(BookTop &top) const {
+    top.num_bids = 0;
+    top.num_asks = 0;
+    buy_orders_.for_each_level([&top](Price price, const LevelQueue &level) {
+        top.bids[top.num_bids++] = {price, level.total_qty};
+        return top.num_bids < BookTop::kDepth;
+    });
+    sell_orders_.for_each_level([&top](Price price, const LevelQueue &level) {
+        top.asks[top.num_asks++] = {price, level.total_qty};
+        return top.num_asks < BookTop::kDepth;
+    });
+}
+
 size_t OrderBook::getBuyOrders() const {
-    size_t total = 0;
-    for (const auto &[price, orders] : buy_orders_) {
-        total += orders.size();
-    }
-    return total;
+    return buy_orders_.orders();
 }
 size_t OrderBook::getSellOrders() const {
-    size_t total = 0;
-    for (const auto &[price, orders] : sell_orders_) {
-        total += orders.size();
-    }
-    return total;
+    return sell_orders_.orders();
 }
 size_t OrderBook::getTotalOrders() const {
     return order_lookup_.size();
@@ -0,0 +1,140 @@
+#include <outbound_buffers.h>
+
+#include "logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+size_t OutboundBuffers::append(int fd, const char *data, size_t len) {
+    if (fd < 0) {
+        return 0;
+    }
+    if (static_cast<size_t>(fd) >= connections_.size()) {
+        connections_.resize(fd + 1);
+    }
+    Connection &conn = connections_[fd];
+    while (len > 0) {
+        if (conn.blocks.empty() || conn.blocks.back().tail == kBlockSize) {
+            Block block;
+            if (free_blocks_.empty()) {
+                block.data.reset(new char[kBlockSize]);
+            } else {
+                block.data = std::move(free_blocks_.back());
+                free_blocks_.pop_back();
+            }
+            conn.blocks.push_back(std::move(block));
+        }
+        Block &block = conn.blocks.back();
+        size_t taken = std::min(len, kBlockSize - block.tail);
+        std::memcpy(block.data.get() + block.tail, data, taken);
+        block.tail += taken;
+        conn.queued += taken;
+        data += taken;
+        len -= taken;
+    }
+    if (!conn.listed && !conn.blocked) {
+        conn.listed = true;
+        dirty_.push_back(fd);
+    }
+    publish(fd, conn);
+    return conn.queued;
+}
+
+void OutboundBuffers::flush() {
+    for (int fd : dirty_) {
+        Connection &conn = connections_[fd];
+        conn.listed      = false;
+        flushConnection(fd, conn);
+        publish(fd, conn);
+    }
+    dirty_.clear();
+}
+
+void OutboundBuffers::writable(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= connections_.size()) {
+        return;
+    }
+    Connection &conn = connections_[fd];
+    conn.blocked     = false;
+    if (conn.queued > 0 && !conn.listed) {
+        conn.listed = true;
+        dirty_.push_back(fd);
+    }
+}
+
+void OutboundBuffers::reset(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= connections_.size()) {
+        return;
+    }
+    Connection &conn = connections_[fd];
+    for (Block &block : conn.blocks) {
+        release(block);
+    }
+    conn.blocks.clear();
+    conn.queued  = 0;
+    conn.blocked = false;
+    publish(fd, conn);
+    // A listed entry stays in dirty_ and finds nothing to write
+}
+
+void OutboundBuffers::flushConnection(int fd, Connection &conn) {
+    while (conn.queued > 0) {
+        iovec iov[kMaxIov];
+        int count = 0;
+        for (const Block &block : conn.blocks) {
+            if (count == kMaxIov) {
+                break;
+            }
+            iov[count].iov_base = block.data.get() + block.head;
+            iov[count].iov_len  = block.tail - block.head;
+            ++count;
+        }
+        msghdr msg{};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = count;
+        // sendmsg is writev for sockets, plus MSG_NOSIGNAL so a closed peer is not SIGPIPE
+        ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn.blocked = true; // The rest goes once the socket drains
+                return;
+            }
+            LOG_WARN << "Send to client " << fd << " failed: " << std::strerror(errno);
+            reset(fd); // The read side sees the error and closes the connection
+            return;
+        }
+        consume(conn, static_cast<size_t>(sent));
+    }
+}
+
+void OutboundBuffers::consume(Connection &conn, size_t len) {
+    conn.queued -= len;
+    size_t done = 0;
+    while (len > 0) {
+        Block &block = conn.blocks[done];
+        size_t taken = std::min(len, block.tail - block.head);
+        block.head += taken;
+        len -= taken;
+        if (block.head < block.tail) {
+            break;
+        }
+        release(block);
+        ++done;
+    }
+    conn.blocks.erase(conn.blocks.begin(), conn.blocks.begin() + done);
+}
+
+void OutboundBuffers::release(Block &block) {
+    free_blocks_.push_back(std::move(block.data));
+}
+
+void OutboundBuffers::publish(int fd, const Connection &conn) {
+    if (static_cast<size_t>(fd) < mirror_size_) {
+        mirror_[fd].store(conn.queued, std::memory_order_relaxed);
+    }
+}
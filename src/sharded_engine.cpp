@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <chrono>
+#include <sharded_engine.h>
+
+#include <../logging/logger.hpp>
+
+ShardedEngine::ShardedEngine(size_t shards, size_t queue_depth,
+                             const std::string &trade_spill_path) {
+    shards_.reserve(shards ? shards : 1);
+    for (size_t i = 0; i < (shards ? shards : 1); ++i) {
+        shards_.push_back(std::make_unique<Shard>(
+            queue_depth, trade_spill_path.empty()
+                             ? trade_spill_path
+                             : trade_spill_path + ".shard" + std::to_string(i)));
+    }
+    // Start threads only once every shard exists so none sees a half-built vector
+    for (auto &shard : shards_) {
+        shard->thread = std::thread([this, s = shard.get()] { run(*s); });
+    }
+    LOG_INFO << "Started " << shards_.size() << " matching shards";
+}
+
+ShardedEngine::~ShardedEngine() {
+    running_.store(false, std::memory_order_release);
+    for (auto &shard : shards_) {
+        shard->thread.join();
+    }
+}
+
+bool ShardedEngine::try_submit(const Command &command) {
+    return try_submit_to(shard_of(command.order.symbol), command);
+}
+
+bool ShardedEngine::try_submit_to(size_t shard, const Command &command) {
+    // Count first so a result polled before this returns never drives pending_ below zero
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    if (!shards_[shard]->inbox.try_push(command)) {
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void ShardedEngine::run(Shard &shard) {
+    Command command;
+    while (running_.load(std::memory_order_acquire)) {
+        if (!shard.inbox.try_pop(command)) {
+            std::this_thread::yield();
+            continue;
+        }
+        execute(shard, command);
+    }
+}
+
+void ShardedEngine::execute(Shard &shard, const Command &command) {
+    MatchingEngine &engine = shard.engine;
+    SymbolId symbol        = command.order.symbol;
+    if (symbol != kInvalidSymbol && !engine.symbols().bound(symbol)) {
+        engine.symbols().bind(symbol, command.symbol, sizeof(command.symbol));
+    }
+
+    Event done;
+    done.fd    = command.fd;
+    done.generation = command.generation;
+    done.quiet = command.quiet;
+    done.order = command.order;
+
+    // Fills of a NEW_ORDER, REPLACE or uncross go out one event each as they execute
+    Event fill;
+    fill.kind      = Event::Kind::TRADE;
+    fill.fd        = command.fd;
+    fill.generation = command.generation;
+    fill.quiet     = command.quiet;
+    auto emit_fill = [&](const Trade &trade) {
+        fill.trade = trade;
+        emit(shard, fill);
+    };
+
+    switch (command.kind) {
+    case Command::Kind::NEW_ORDER: {
+        auto start = std::chrono::steady_clock::now();
+        done.outcome = engine.process_new_order(command.order, emit_fill).outcome;
+        done.latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+        done.kind       = Event::Kind::ORDER_DONE;
+        OrderBook *book = engine.get_order_book(symbol);
+        done.found      = book && book->getOrderbyId(command.order.id);
+        emit_levels(shard, symbol);
+        break;
+    }
+    case Command::Kind::CANCEL: {
+        done.kind = Event::Kind::CANCEL_DONE;
+        if (auto cancelled = engine.cancel_order(command.order.id, symbol,
+                                                 static_cast<int>(command.order.side))) {
+            done.order = *cancelled;
+            done.found = true;
+        }
+        emit_levels(shard, symbol);
+        break;
+    }
+    case Command::Kind::REPLACE: {
+        done.kind = Event::Kind::REPLACE_DONE;
+        if (auto replaced = engine.modify_order(command.order.id, symbol, command.order.price,
+                                                command.order.quantity, emit_fill)) {
+            done.order = *replaced;
+            done.found = true;
+        }
+        emit_levels(shard, symbol);
+        break;
+    }
+    case Command::Kind::MASS_CANCEL: {
+        done.kind = Event::Kind::MASS_CANCEL_DONE;
+        std::vector<Order> cancelled = command.all_users
+                                           ? engine.cancel_all(symbol)
+                                           : engine.mass_cancel(command.order.user_id, symbol,
+                                                                command.order.session);
+        // Group by symbol so each book's level changes follow its last cancel
+        std::stable_sort(cancelled.begin(), cancelled.end(),
+                         [](const Order &a, const Order &b) { return a.symbol < b.symbol; });
+        Event event;
+        event.kind  = Event::Kind::CANCELLED;
+        event.fd    = command.fd;
+        event.generation = command.generation;
+        event.quiet = command.quiet;
+        for (size_t i = 0; i < cancelled.size(); ++i) {
+            event.order = cancelled[i];
+            emit(shard, event);
+            if (i + 1 == cancelled.size() || cancelled[i + 1].symbol != cancelled[i].symbol) {
+                emit_levels(shard, cancelled[i].symbol);
+            }
+        }
+        done.found = !cancelled.empty();
+        break;
+    }
+    case Command::Kind::PHASE:
+        done.kind = Event::Kind::PHASE_DONE;
+        if (command.auction) {
+            engine.begin_auction(symbol);
+        } else {
+            engine.uncross(symbol, emit_fill);
+        }
+        emit_levels(shard, symbol);
+        break;
+    case Command::Kind::LEVELS: {
+        done.kind = Event::Kind::LEVELS_DONE;
+        Event level;
+        level.kind         = Event::Kind::LEVEL;
+        level.order.symbol = symbol;
+        engine.get_or_create_order_book(symbol).start_level_updates(
+            [&](const LevelUpdate &update) {
+                level.level = update;
+                emit(shard, level);
+            });
+        break;
+    }
+    }
+    emit(shard, done);
+}
+
+// Block until the gateway makes room; results are never dropped
+void ShardedEngine::emit(Shard &shard, const Event &event) {
+    while (!shard.outbox.try_push(event)) {
+        if (!running_.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+// Level changes of a book with a started feed, one LEVEL event each
+void ShardedEngine::emit_levels(Shard &shard, SymbolId symbol) {
+    OrderBook *book = shard.engine.get_order_book(symbol);
+    if (!book || !book->records_level_updates()) {
+        return;
+    }
+    Event level;
+    level.kind         = Event::Kind::LEVEL;
+    level.order.symbol = symbol;
+    book->drain_level_updates([&](const LevelUpdate &update) {
+        level.level = update;
+        emit(shard, level);
+    });
+}
@@ -1,15 +1,22 @@
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
-#include <fcntl.h>
+#include <ctime>
+#include <io_uring_backend.h>
 #include <iostream>
 #include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <tcp_server.h>
 #include <unistd.h>
-#include <vector>
 #include "logger.hpp"
 
-TcpServer::TcpServer(int port) : port_(port), running_(false) {
-    serverFd_ = socket(AF_INET, SOCK_STREAM, 0);
+TcpServer::TcpServer(int port, bool busy_poll, int idle_timeout_us, Backend backend)
+    : epollFd_(-1), port_(port), busyPoll_(busy_poll), idleTimeoutUs_(idle_timeout_us),
+      running_(false) {
+    serverFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
     int opt   = 1;
     setsockopt(serverFd_, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt));
 
@@ -19,86 +26,306 @@ TcpServer::TcpServer(int port) : port_(port), running_(false) {
     addr.sin_port        = htons(port);
 
     bind(serverFd_, (sockaddr *)&addr, sizeof(addr));
-    listen(serverFd_, 10);
+    listen(serverFd_, kListenBacklog);
 
-    fcntl(serverFd_, F_SETFL, O_NONBLOCK);
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    maxTrackedFds_ = static_cast<size_t>(std::min<rlim_t>(limit.rlim_cur, kMaxTrackedFds));
+    generations_   = std::make_unique<std::atomic<uint32_t>[]>(maxTrackedFds_);
+    queued_        = std::make_unique<std::atomic<size_t>[]>(maxTrackedFds_);
+    handedOff_     = std::make_unique<std::atomic<size_t>[]>(maxTrackedFds_);
+    wakeFd_        = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (backend == Backend::IO_URING) {
+        uring_ = IoUringBackend::create(serverFd_, wakeFd_);
+        if (uring_) {
+            uring_->mirrorQueued(queued_.get(), maxTrackedFds_);
+            return;
+        }
+        LOG_WARN << "io_uring backend unavailable, using epoll";
+    }
+    outbox_.mirrorQueued(queued_.get(), maxTrackedFds_);
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events  = EPOLLIN | EPOLLET;
+    event.data.fd = serverFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, serverFd_, &event);
+    event.data.fd = wakeFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event);
 }
 
 TcpServer::~TcpServer() {
     running_ = false;
+    uring_.reset();
+    if (epollFd_ >= 0) {
+        close(epollFd_);
+    }
+    close(wakeFd_);
     close(serverFd_);
 }
 
 void TcpServer::sendPacket(int fd, const char *data, size_t len) {
-    send(fd, data, len, 0);
+    sendPacket(fd, data, len, generation(fd));
+}
+
+void TcpServer::sendPacket(int fd, const char *data, size_t len, uint32_t generation) {
+    if (fd < 0) {
+        return;
+    }
+    // The queues and sockets belong to the loop thread; other threads hand packets to it
+    if (std::this_thread::get_id() != loopThread_.load(std::memory_order_relaxed)) {
+        handOff(fd, data, len, generation);
+        return;
+    }
+    if (generation != this->generation(fd)) {
+        return; // The connection it was for has closed; its fd may be someone else's now
+    }
+    size_t queued = uring_ ? uring_->send(fd, data, len) : outbox_.append(fd, data, len);
+    // Report each crossing once; the queue has to drain below the mark to re-arm
+    if (queued > sendHighWater_ && queued - len <= sendHighWater_ && onSlowConsumer_) {
+        onSlowConsumer_(fd, queued);
+    }
+    if (queued > sendLimit_) {
+        dropClient(fd, queued);
+    }
+}
+
+size_t TcpServer::queuedBytes(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= maxTrackedFds_) {
+        if (std::this_thread::get_id() != loopThread_.load(std::memory_order_relaxed)) {
+            return 0; // Untracked fds can only be read by their owner
+        }
+        return uring_ ? uring_->queued(fd) : outbox_.queued(fd);
+    }
+    return queued_[fd].load(std::memory_order_relaxed) +
+           handedOff_[fd].load(std::memory_order_relaxed);
+}
+
+void TcpServer::handOff(int fd, const char *data, size_t len, uint32_t generation) {
+    Handoff header{fd, generation, static_cast<uint32_t>(len)};
+    if (static_cast<size_t>(fd) < maxTrackedFds_) {
+        handedOff_[fd].fetch_add(len, std::memory_order_relaxed);
+    }
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(handoffMutex_);
+        wake = handoff_.empty();
+        const char *bytes = reinterpret_cast<const char *>(&header);
+        handoff_.insert(handoff_.end(), bytes, bytes + sizeof(header));
+        handoff_.insert(handoff_.end(), data, data + len);
+        handoffPending_.store(true, std::memory_order_release);
+    }
+    // Only the first packet of a batch wakes the loop; it takes the whole batch at once
+    uint64_t one = 1;
+    if (wake && write(wakeFd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        LOG_WARN << "Failed to wake the network loop: " << std::strerror(errno);
+    }
+}
+
+void TcpServer::drainHandoff() {
+    if (!handoffPending_.load(std::memory_order_acquire)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(handoffMutex_);
+        handoff_.swap(handoffBatch_);
+        handoffPending_.store(false, std::memory_order_relaxed);
+    }
+    for (size_t at = 0; at < handoffBatch_.size();) {
+        Handoff header;
+        std::memcpy(&header, handoffBatch_.data() + at, sizeof(header));
+        const char *data = handoffBatch_.data() + at + sizeof(header);
+        at += sizeof(header) + header.len;
+        // Drop packets for a connection that closed since; its fd may be someone else's now
+        uint32_t current = generation(header.fd);
+        if (header.generation == current && (current & 1)) {
+            sendPacket(header.fd, data, header.len);
+        }
+        if (static_cast<size_t>(header.fd) < maxTrackedFds_) {
+            handedOff_[header.fd].fetch_sub(header.len, std::memory_order_relaxed);
+        }
+    }
+    handoffBatch_.clear();
+}
+
+// Odd while a connection is open on `fd`; fds past the table are never checked
+uint32_t TcpServer::generation(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= maxTrackedFds_) {
+        return 1;
+    }
+    return generations_[fd].load(std::memory_order_acquire);
+}
+
+void TcpServer::bumpGeneration(int fd) {
+    if (fd >= 0 && static_cast<size_t>(fd) < maxTrackedFds_) {
+        generations_[fd].fetch_add(1, std::memory_order_release);
+    }
 }
 
 void TcpServer::start() {
     running_ = true;
-    std::vector<int> clients;
-    char buffer[1024];
+    loopThread_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    epoll_event events[kMaxEvents];
 
-    LOG_INFO << "Server started on port " << port_;
+    // The io_uring backend reports connections through these, keeping generations in step
+    OnConnection on_connection = [this](int fd) {
+        bumpGeneration(fd);
+        if (onConnection_) {
+            onConnection_(fd);
+        }
+    };
+    OnDisconnection on_disconnection = [this](int fd) {
+        bumpGeneration(fd);
+        if (onDisconnection_) {
+            onDisconnection_(fd);
+        }
+    };
+
+    LOG_INFO << "Server started on port " << port_ << (uring_ ? " (io_uring)" : " (epoll)")
+             << (busyPoll_ ? " (busy poll)" : "");
 
     while (running_) {
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(serverFd_, &fds);
-        int max_fd = serverFd_;
-
-        for (int client_fd : clients) {
-            FD_SET(client_fd, &fds);
-            if (client_fd > max_fd) {
-                max_fd = client_fd;
-            }
+        if (onIdle_) {
+            onIdle_();
         }
-        timeval tv{0, 100}; // 100ms
-        int activity = select(max_fd + 1, &fds, nullptr, nullptr, &tv);
-        if (activity < 0) {
+        drainHandoff();
+        if (uring_) {
+            uring_->poll(waitTimeoutUs(), on_connection, onMessage_, on_disconnection);
             continue;
         }
-        if (FD_ISSET(serverFd_, &fds)) {
-            int new_client = accept(serverFd_, nullptr, nullptr);
-            if (new_client >= 0) {
-                LOG_INFO << "New client connected: " << new_client;
-                fcntl(new_client, F_SETFL, O_NONBLOCK);
-                clients.push_back(new_client);
-                if (onConnection_) {
-                    onConnection_(new_client);
+        outbox_.flush(); // Everything queued since the last wait, one write per connection
+        int ready = wait(events);
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == serverFd_) {
+                acceptClients();
+                continue;
+            }
+            if (fd == wakeFd_) {
+                uint64_t count; // Reset the eventfd; the next iteration drains the handoff
+                if (read(wakeFd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    LOG_WARN << "Failed to read the wakeup eventfd: " << std::strerror(errno);
                 }
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                outbox_.writable(fd);
+            }
+            if (events[i].events & ~EPOLLOUT) {
+                // Read even on hang-up or error so data sent before the close is not lost;
+                // readClient closes the socket once recv reports the end
+                readClient(fd);
             }
         }
-        for (auto it = clients.begin(); it != clients.end();) {
-            int client_fd = *it;
-            if (FD_ISSET(client_fd, &fds)) {
-                ssize_t bytes_read = recv(client_fd, buffer, sizeof(buffer), 0);
-                LOG_DEBUG << "Received data from client " << client_fd << ": " << bytes_read
-                          << " bytes";
-                if (bytes_read > 0) {
-                    if (onMessage_) {
-                        onMessage_(client_fd, buffer, bytes_read);
-                    }
-                    ++it;
-                } else if (bytes_read == 0) {
-                    if (onDisconnection_) {
-                        onDisconnection_(client_fd);
-                    }
-                    close(client_fd);
-                    it = clients.erase(it);
-                } else {
-                    if (errno != EWOULDBLOCK && errno != EAGAIN) {
-                        if (onDisconnection_) {
-                            onDisconnection_(client_fd);
-                        }
-                        close(client_fd);
-                        it = clients.erase(it);
-                    } else {
-                        ++it;
-                    }
-                }
-            } else {
-                ++it;
+    }
+}
+
+void TcpServer::stop() {
+    running_ = false;
+    uint64_t one = 1; // End a wait in progress
+    if (write(wakeFd_, &one, sizeof(one)) < 0) {
+        LOG_WARN << "Failed to wake the server loop: " << std::strerror(errno);
+    }
+}
+
+// 0 = don't sleep, -1 = sleep until a socket is ready
+int TcpServer::waitTimeoutUs() const {
+    if (busyPoll_) {
+        return 0;
+    }
+    // Without a timed idle hook there is nothing to do until a socket is ready
+    return onIdle_ && idleTimed_ ? idleTimeoutUs_ : -1;
+}
+
+int TcpServer::wait(epoll_event *events) {
+    int timeout_us = waitTimeoutUs();
+    if (timeout_us <= 0) {
+        return epoll_wait(epollFd_, events, kMaxEvents, timeout_us);
+    }
+    if (hasPwait2_) {
+        timespec timeout{idleTimeoutUs_ / 1000000, (idleTimeoutUs_ % 1000000) * 1000L};
+        int ready = epoll_pwait2(epollFd_, events, kMaxEvents, &timeout, nullptr);
+        if (ready >= 0 || errno != ENOSYS) {
+            return ready;
+        }
+        hasPwait2_ = false;
+    }
+    return epoll_wait(epollFd_, events, kMaxEvents, (idleTimeoutUs_ + 999) / 1000);
+}
+
+void TcpServer::acceptClients() {
+    // Edge-triggered: take every pending connection now, there is no second notification
+    while (true) {
+        int client_fd = accept4(serverFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
             }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARN << "accept failed: " << std::strerror(errno);
+            }
+            return;
+        }
+        epoll_event event{};
+        event.events  = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = client_fd;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, client_fd, &event) < 0) {
+            LOG_WARN << "Failed to watch client " << client_fd << ": " << std::strerror(errno);
+            close(client_fd);
+            continue;
+        }
+        LOG_INFO << "New client connected: " << client_fd;
+        bumpGeneration(client_fd);
+        if (onConnection_) {
+            onConnection_(client_fd);
+        }
+    }
+}
+
+void TcpServer::readClient(int fd) {
+    char buffer[kRecvChunk];
+    // Edge-triggered: drain the socket until EAGAIN or it will not be reported again
+    while (true) {
+        auto [target, space] = recvBuffer_ ? recvBuffer_(fd) : std::pair<char *, size_t>{};
+        if (space == 0) {
+            target = buffer;
+            space  = sizeof(buffer);
+        }
+        ssize_t bytes_read = recv(fd, target, space, 0);
+        LOG_DEBUG << "Received data from client " << fd << ": " << bytes_read << " bytes";
+        if (bytes_read > 0) {
+            if (onMessage_) {
+                onMessage_(fd, target, bytes_read);
+            }
+        } else if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        } else if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            closeClient(fd); // Orderly shutdown or a socket error
+            return;
         }
     }
-}
\ No newline at end of file
+}
+
+void TcpServer::dropClient(int fd, size_t queued) {
+    LOG_WARN << "Client " << fd << " has " << queued << " bytes queued, over the "
+             << sendLimit_ << " byte limit; disconnecting";
+    if (uring_) {
+        uring_->discard(fd);
+    } else {
+        outbox_.reset(fd);
+    }
+    // Not closed here: callers may still be working on the fd. The receive side sees the
+    // shutdown and closes it through the usual path.
+    shutdown(fd, SHUT_RDWR);
+}
+
+void TcpServer::closeClient(int fd) {
+    bumpGeneration(fd);
+    outbox_.reset(fd);
+    if (onDisconnection_) {
+        onDisconnection_(fd);
+    }
+    close(fd); // Also removes it from the epoll set
+}
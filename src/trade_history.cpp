@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <trade_history.h>
+#include <unistd.h>
+
+#include <../logging/logger.hpp>
+
+TradeHistory::TradeHistory(size_t capacity, const std::string &spill_path)
+    : ring_(std::bit_ceil(capacity ? capacity : 1)) {
+    if (spill_path.empty()) {
+        return;
+    }
+    std::error_code ec; // A failure shows up in the open below
+    std::filesystem::create_directories(std::filesystem::path(spill_path).parent_path(), ec);
+    spill_fd_ = ::open(spill_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (spill_fd_ < 0) {
+        LOG_ERROR << "Cannot open trade spill file " << spill_path << ": " << std::strerror(errno)
+                  << ". Trades older than the last " << ring_.size() << " will be dropped.";
+        dropping_ = true; // Already reported
+        return;
+    }
+    LOG_INFO << "Spilling trade history beyond " << ring_.size() << " trades to " << spill_path;
+}
+
+TradeHistory::~TradeHistory() {
+    for (Record *chunk : chunks_) {
+        ::munmap(chunk, kRecordsPerChunk * sizeof(Record));
+    }
+    if (spill_fd_ >= 0) {
+        // Drop the unused tail of the last chunk so the file holds exactly the spilled records
+        if (::ftruncate(spill_fd_, static_cast<off_t>(spilled_ * sizeof(Record))) != 0) {
+            LOG_WARN << "Cannot trim trade spill file: " << std::strerror(errno);
+        }
+        ::close(spill_fd_);
+    }
+}
+
+uint64_t TradeHistory::append(const Trade &trade) {
+    uint64_t sequence = next_sequence_++;
+    Trade &slot       = ring_[sequence & (ring_.size() - 1)];
+    if (sequence >= ring_.size()) {
+        spill(slot); // Slot still holds the trade from one ring length ago
+    }
+    slot          = trade;
+    slot.sequence = sequence;
+    if (trade.timestamp < last_timestamp_ && time_ordered_) {
+        time_ordered_ = false;
+        LOG_WARN << "Trade timestamps went backwards (clock step?): time range queries scan "
+                    "the whole history from now on.";
+    }
+    last_timestamp_ = trade.timestamp;
+    return sequence;
+}
+
+uint64_t TradeHistory::ring_begin() const {
+    return next_sequence_ > ring_.size() ? next_sequence_ - ring_.size() : 0;
+}
+
+uint64_t TradeHistory::first_available() const {
+    return spilled_ > 0 ? 0 : ring_begin();
+}
+
+Trade TradeHistory::at(uint64_t sequence) const {
+    if (sequence >= ring_begin()) {
+        return ring_at(sequence);
+    }
+    const Record &r = spilled_at(sequence);
+    return Trade{.buy_order_id  = r.buy_order_id,
+                 .buy_user_id   = r.buy_user_id,
+                 .sell_order_id = r.sell_order_id,
+                 .sell_user_id  = r.sell_user_id,
+                 .symbol        = r.symbol,
+                 .price         = r.price,
+                 .quantity      = r.quantity,
+                 .timestamp     = r.timestamp,
+                 .sequence      = r.sequence};
+}
+
+std::vector<Trade> TradeHistory::range_by_sequence(uint64_t first, uint64_t last) const {
+    std::vector<Trade> trades;
+    last = std::min(last, next_sequence_);
+    // Spilled records cover [0, spilled_) and the ring covers [ring_begin(), next_sequence_);
+    // the gap between them (if spilling failed or is disabled) is skipped
+    for (uint64_t seq = first; seq < std::min(last, spilled_); ++seq) {
+        trades.push_back(at(seq));
+    }
+    for (uint64_t seq = std::max(first, ring_begin()); seq < last; ++seq) {
+        trades.push_back(at(seq));
+    }
+    return trades;
+}
+
+std::vector<Trade> TradeHistory::range_by_time(Timestamp from, Timestamp to) const {
+    // First sequence in [lo, hi) whose timestamp is not below `ts`
+    auto lower_bound = [this](uint64_t lo, uint64_t hi, Timestamp ts) {
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (at(mid).timestamp < ts) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    };
+
+    std::vector<Trade> trades;
+    // Search the spilled records and the ring separately, oldest first
+    for (auto [lo, hi] :
+         {std::pair{uint64_t{0}, spilled_}, std::pair{ring_begin(), next_sequence_}}) {
+        if (!time_ordered_) {
+            for (uint64_t seq = lo; seq < hi; ++seq) {
+                Trade trade = at(seq);
+                if (trade.timestamp >= from && trade.timestamp < to) {
+                    trades.push_back(trade);
+                }
+            }
+            continue;
+        }
+        uint64_t begin = lower_bound(lo, hi, from);
+        uint64_t end   = lower_bound(begin, hi, to);
+        for (uint64_t seq = begin; seq < end; ++seq) {
+            trades.push_back(at(seq));
+        }
+    }
+    return trades;
+}
+
+void TradeHistory::spill(const Trade &trade) {
+    if (spill_fd_ < 0) {
+        if (!dropping_) {
+            dropping_ = true;
+            LOG_WARN << "No trade spill file: trades older than the last " << ring_.size()
+                     << " are dropped from now on and missing from range queries.";
+        }
+        return;
+    }
+    if (spilled_ == chunks_.size() * kRecordsPerChunk && !map_chunk()) {
+        return;
+    }
+    Record &record = chunks_.back()[spilled_ % kRecordsPerChunk];
+    record         = Record{.sequence      = trade.sequence,
+                            .timestamp     = trade.timestamp,
+                            .price         = trade.price,
+                            .quantity      = trade.quantity,
+                            .buy_order_id  = trade.buy_order_id,
+                            .sell_order_id = trade.sell_order_id,
+                            .buy_user_id   = trade.buy_user_id,
+                            .sell_user_id  = trade.sell_user_id,
+                            .symbol        = trade.symbol,
+                            .reserved      = 0};
+    ++spilled_;
+}
+
+// Extend the file by one chunk and map it. On failure spilling stops; records
+// already written stay readable.
+bool TradeHistory::map_chunk() {
+    size_t chunk_bytes = kRecordsPerChunk * sizeof(Record);
+    auto offset        = static_cast<off_t>(chunks_.size() * chunk_bytes);
+    void *addr         = MAP_FAILED;
+    if (::ftruncate(spill_fd_, offset + static_cast<off_t>(chunk_bytes)) == 0) {
+        addr = ::mmap(nullptr, chunk_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, spill_fd_, offset);
+    }
+    if (addr == MAP_FAILED) {
+        LOG_ERROR << "Cannot extend trade spill file: " << std::strerror(errno)
+                  << ". Older trades will be dropped from now on.";
+        if (::ftruncate(spill_fd_, offset) != 0) {
+            LOG_WARN << "Cannot trim trade spill file: " << std::strerror(errno);
+        }
+        ::close(spill_fd_);
+        spill_fd_ = -1;
+        dropping_ = true; // Already reported
+        return false;
+    }
+    chunks_.push_back(static_cast<Record *>(addr));
+    return true;
+}
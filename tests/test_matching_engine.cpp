@@ -1,6 +1,28 @@
 #include "logger.hpp"
 #include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <client_gateway.h>
+#include <config.h>
+#include <cstring>
+#include <filesystem>
+#include <flat_hash_map.h>
+#include <l2_feed.h>
+#include <level_bitmap.h>
 #include <matching_engine.h>
+#include <mpsc_queue.h>
+#include <outbound_buffers.h>
+#include <random>
+#include <recv_buffer.h>
+#include <map>
+#include <set>
+#include <sharded_engine.h>
+#include <sys/socket.h>
+#include <tcp_server.h>
+#include <thread>
+#include <trade_history.h>
+#include <tuple>
+#include <unistd.h>
+#include <unordered_map>
 
 class MatchingEngineTest : public ::testing::Test {
   protected:
@@ -22,22 +44,26 @@ class MatchingEngineTest : public ::testing::Test {
     Order makeOrder(OrderID id, Symbol symbol, OrderSide side, OrderType type, Price price,
                     Quantity quantity) {
         return Order{.id        = id,
-                     .symbol    = symbol,
+                     .symbol    = engine.symbols().intern(symbol),
                      .side      = side,
                      .type      = type,
                      .price     = price,
                      .quantity  = quantity,
                      .timestamp = 0};
     }
+    // Resting orders for driving an OrderBook directly, bypassing the engine's pool
+    static RestingOrder makeResting(OrderID id, OrderSide side, Price price, Quantity quantity) {
+        return RestingOrder{.id = id, .price = price, .quantity = quantity, .side = side};
+    }
 };
 
 // Test_1 :Validate Input Orders
 TEST_F(MatchingEngineTest, ValidateOrder) {
-    Order valid = makeOrder(1, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150.0, 100);
+    Order valid = makeOrder(1, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150, 100);
     EXPECT_TRUE(engine.validate_order(valid));
 
     // Invalid Order: Negative Price
-    Order invalid_price = makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, -150.0, 100);
+    Order invalid_price = makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, -150, 100);
     EXPECT_FALSE(engine.validate_order(invalid_price));
 }
 // Test_2: Get or Create Order Book
@@ -50,14 +76,14 @@ TEST_F(MatchingEngineTest, GetOrCreateOrderBook) {
 // Test_3: Process book statistics
 TEST_F(MatchingEngineTest, ProcessOrderStats) {
     OrderBook &book = engine.get_or_create_order_book("AAPL");
-    Order order1    = makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100);
+    RestingOrder order1 = makeResting(1, OrderSide::SELL, 150, 100);
     book.add_order(&order1);
     EXPECT_EQ(book.getTotalOrders(), 1);
 }
 
 TEST_F(MatchingEngineTest, ProcessNewOrder) {
-    Order sell = makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100);
-    Order buy  = makeOrder(2, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150.0, 100);
+    Order sell = makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100);
+    Order buy  = makeOrder(2, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150, 100);
 
     auto trades1 = engine.process_new_order(sell);
     EXPECT_EQ(trades1.size(),
@@ -67,7 +93,7 @@ TEST_F(MatchingEngineTest, ProcessNewOrder) {
     EXPECT_EQ(trades2.size(),
               1);                        // One trade should be generated from the second order
     EXPECT_EQ(trades2[0].quantity, 100); // Trade quantity should be 100
-    EXPECT_EQ(trades2[0].price, 150.0);  // Trade price should be 150.0
+    EXPECT_EQ(trades2[0].price, 150);  // Trade price should be 150
 
     OrderBook *book = engine.get_order_book("AAPL");
     EXPECT_EQ(book->getTotalOrders(),
@@ -75,8 +101,8 @@ TEST_F(MatchingEngineTest, ProcessNewOrder) {
 }
 
 TEST_F(MatchingEngineTest, PartialFill) {
-    Order sell = makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100);
-    Order buy  = makeOrder(2, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150.0, 50);
+    Order sell = makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100);
+    Order buy  = makeOrder(2, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150, 50);
 
     auto trades1 = engine.process_new_order(sell);
     EXPECT_EQ(trades1.size(),
@@ -86,7 +112,7 @@ TEST_F(MatchingEngineTest, PartialFill) {
     EXPECT_EQ(trades2.size(),
               1);                       // One trade should be generated from the second order
     EXPECT_EQ(trades2[0].quantity, 50); // Trade quantity should be 50
-    EXPECT_EQ(trades2[0].price, 150.0); // Trade price should be 150.0
+    EXPECT_EQ(trades2[0].price, 150); // Trade price should be 150
 
     OrderBook *book = engine.get_order_book("AAPL");
     EXPECT_EQ(book->getTotalOrders(), 1); // Sell order should have 50 remaining
@@ -96,25 +122,25 @@ TEST_F(MatchingEngineTest, PartialFill) {
 
 TEST_F(MatchingEngineTest, PriceImprovement) {
     // Sell @ 150
-    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100));
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100));
 
     // Buy @ 155 (Aggressive buy)
     // Should execute at 150 (Best Ask), not 155
     auto trades = engine.process_new_order(
-        makeOrder(2, "AAPL", OrderSide::BUY, OrderType::LIMIT, 155.0, 100));
+        makeOrder(2, "AAPL", OrderSide::BUY, OrderType::LIMIT, 155, 100));
 
-    EXPECT_EQ(trades[0].price, 150.0);
+    EXPECT_EQ(trades[0].price, 150);
 }
 
 TEST_F(MatchingEngineTest, FIFOMatching) {
     // Sell 100 @ 150
-    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100));
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100));
     // Sell 100 @ 150
-    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100));
 
     // Buy 150 @ 150
     auto trades = engine.process_new_order(
-        makeOrder(3, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150.0, 150));
+        makeOrder(3, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150, 150));
 
     // First trade should fill order ID 1 completely
     EXPECT_EQ(trades[0].buy_order_id, 3);
@@ -135,7 +161,7 @@ TEST_F(MatchingEngineTest, FIFOMatching) {
 
 TEST_F(MatchingEngineTest, OrderCancellation) {
     // Sell 100 @ 150
-    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100));
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100));
 
     OrderBook *book = engine.get_order_book("AAPL");
     EXPECT_EQ(book->getTotalOrders(), 1); // One order should be in the book
@@ -151,17 +177,17 @@ TEST_F(MatchingEngineTest, OrderCancellation) {
 
 TEST_F(MatchingEngineTest, IOC_NoLiquidity) {
     auto trades =
-        engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::IOC, 150.0, 100));
+        engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::IOC, 150, 100));
     EXPECT_EQ(trades.size(), 0); // No trades should be executed
 }
 
 TEST_F(MatchingEngineTest, IOC_PartialFill) {
     // Sell 50 @ 150
-    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 50));
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 50));
 
     // Buy 100 @ 150 with IOC
     auto trades =
-        engine.process_new_order(makeOrder(2, "AAPL", OrderSide::BUY, OrderType::IOC, 150.0, 100));
+        engine.process_new_order(makeOrder(2, "AAPL", OrderSide::BUY, OrderType::IOC, 150, 100));
 
     EXPECT_EQ(trades.size(), 1);       // One trade should be executed
     EXPECT_EQ(trades[0].quantity, 50); // Trade quantity should be 50
@@ -173,11 +199,11 @@ TEST_F(MatchingEngineTest, IOC_PartialFill) {
 // --------FOK Tests-------- //
 TEST_F(MatchingEngineTest, FOK_NotEnoughLiquidity) {
     // Sell 50 @ 150
-    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 50));
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 50));
 
     // Buy 100 @ 150 with FOK
     auto trades =
-        engine.process_new_order(makeOrder(2, "AAPL", OrderSide::BUY, OrderType::FOK, 150.0, 100));
+        engine.process_new_order(makeOrder(2, "AAPL", OrderSide::BUY, OrderType::FOK, 150, 100));
 
     EXPECT_EQ(trades.size(), 0); // No trades should be executed
 
@@ -188,12 +214,12 @@ TEST_F(MatchingEngineTest, FOK_NotEnoughLiquidity) {
 
 TEST_F(MatchingEngineTest, FOK_FullFill) {
     // Sell 100 @ 150
-    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100));
-    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 101));
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 101));
 
     // Buy 201 @ 150 with FOK
     auto trades =
-        engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::FOK, 150.0, 201));
+        engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::FOK, 150, 201));
 
     EXPECT_EQ(trades.size(), 2);        // Two trades should be executed
     EXPECT_EQ(trades[0].quantity, 100); // First trade quantity should be 100
@@ -203,21 +229,98 @@ TEST_F(MatchingEngineTest, FOK_FullFill) {
     EXPECT_EQ(book->getTotalOrders(), 0); // No orders should remain in the book
 }
 
+TEST_F(MatchingEngineTest, FOK_CountsOnlyLevelsWithinLimit) {
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 100, 10));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 100, 5));
+    engine.process_new_order(makeOrder(3, "AAPL", OrderSide::SELL, OrderType::LIMIT, 101, 10));
+    engine.process_new_order(makeOrder(4, "AAPL", OrderSide::SELL, OrderType::LIMIT, 105, 50));
+
+    // The side holds 75, but only 25 is at 101 or better
+    EXPECT_TRUE(
+        engine.process_new_order(makeOrder(5, "AAPL", OrderSide::BUY, OrderType::FOK, 101, 26))
+            .empty());
+    // More than the whole side is rejected without walking any level
+    EXPECT_TRUE(
+        engine.process_new_order(makeOrder(6, "AAPL", OrderSide::BUY, OrderType::FOK, 200, 76))
+            .empty());
+    EXPECT_EQ(engine.get_order_book("AAPL")->getSellOrders(), 4);
+
+    // Exactly enough ends part way into the last level it needs
+    auto trades =
+        engine.process_new_order(makeOrder(7, "AAPL", OrderSide::BUY, OrderType::FOK, 101, 22));
+    ASSERT_EQ(trades.size(), 3);
+    EXPECT_EQ(trades[2].sell_order_id, 3);
+    EXPECT_EQ(trades[2].quantity, 7);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->remaining_qty(), 3);
+    EXPECT_EQ(engine.get_order_book("AAPL")->ladder<OrderSide::SELL>().total_qty(), 53);
+}
+
+// --------Auction Tests-------- //
+TEST_F(MatchingEngineTest, AuctionUncrossesAtEquilibriumPrice) {
+    SymbolId aapl = engine.symbols().intern("AAPL");
+    engine.begin_auction(aapl);
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::LIMIT, 102, 10));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::BUY, OrderType::LIMIT, 101, 20));
+    engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::LIMIT, 99, 30));
+    engine.process_new_order(makeOrder(4, "AAPL", OrderSide::SELL, OrderType::LIMIT, 98, 15));
+    engine.process_new_order(makeOrder(5, "AAPL", OrderSide::SELL, OrderType::LIMIT, 100, 10));
+    engine.process_new_order(makeOrder(6, "AAPL", OrderSide::SELL, OrderType::LIMIT, 101, 10));
+    // Nothing matches during the call, and immediate-execution orders are turned away
+    EXPECT_TRUE(
+        engine.process_new_order(makeOrder(7, "AAPL", OrderSide::BUY, OrderType::IOC, 110, 5))
+            .empty());
+    OrderBook *book = engine.get_order_book(aapl);
+    EXPECT_EQ(book->getTotalOrders(), 6);
+    EXPECT_EQ(book->getBestBid()->price, 102);
+    EXPECT_EQ(book->getBestAsk()->price, 98);
+
+    // 30 can trade at 101 (demand 30, supply 35); every other price trades less
+    std::vector<Trade> trades;
+    EXPECT_EQ(engine.uncross(aapl, [&](const Trade &t) { trades.push_back(t); }), 4);
+    Quantity volume = 0;
+    for (const Trade &t : trades) {
+        EXPECT_EQ(t.price, 101);
+        volume += t.quantity;
+    }
+    EXPECT_EQ(volume, 30);
+    EXPECT_EQ(trades[0].buy_order_id, 1);
+    EXPECT_EQ(trades[0].sell_order_id, 4);
+    EXPECT_EQ(book->getBestBid()->price, 99);
+    EXPECT_EQ(book->getBestAsk()->price, 101);
+    EXPECT_EQ(book->getBestAsk()->remaining_qty(), 5);
+
+    // Back to continuous matching
+    EXPECT_EQ(
+        engine.process_new_order(makeOrder(8, "AAPL", OrderSide::SELL, OrderType::LIMIT, 99, 5))
+            .size(),
+        1);
+
+    // A balanced tie over a range of prices crosses in the middle of it
+    SymbolId msft = engine.symbols().intern("MSFT");
+    engine.begin_auction(msft);
+    engine.process_new_order(makeOrder(9, "MSFT", OrderSide::BUY, OrderType::LIMIT, 105, 10));
+    engine.process_new_order(makeOrder(10, "MSFT", OrderSide::SELL, OrderType::LIMIT, 95, 10));
+    trades.clear();
+    EXPECT_EQ(engine.uncross(msft, [&](const Trade &t) { trades.push_back(t); }), 1);
+    EXPECT_EQ(trades[0].price, 100);
+    EXPECT_EQ(engine.get_order_book(msft)->getTotalOrders(), 0);
+}
+
 // --------Market Order Tests-------- //
 TEST_F(MatchingEngineTest, MarketOrderExecution) {
     // Sell 100 @ 150 and 200 @ 151
-    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100));
-    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 151.0, 200));
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 151, 200));
 
     // Buy 150 @ Market price (should match at 150)
     auto trades =
-        engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::MARKET, 0.0, 150));
+        engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::MARKET, 0, 150));
 
     EXPECT_EQ(trades.size(), 2);        // Two trades should be executed
     EXPECT_EQ(trades[0].quantity, 100); // First trade quantity should be 100
-    EXPECT_EQ(trades[0].price, 150.0);  // First trade price should be 150.0
+    EXPECT_EQ(trades[0].price, 150);  // First trade price should be 150
     EXPECT_EQ(trades[1].quantity, 50);  // Second trade quantity should be 50
-    EXPECT_EQ(trades[1].price, 151.0);  // Second trade price should be 151.0
+    EXPECT_EQ(trades[1].price, 151);  // Second trade price should be 151
 
     OrderBook *book = engine.get_order_book("AAPL");
     EXPECT_EQ(book->getTotalOrders(),
@@ -229,7 +332,7 @@ TEST_F(MatchingEngineTest, MarketOrderExecution) {
 TEST_F(MatchingEngineTest, MarketOrderNoLiquidity) {
     // Buy 100 @ Market price (should not execute)
     auto trades =
-        engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::MARKET, 0.0, 100));
+        engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::MARKET, 0, 100));
 
     EXPECT_EQ(trades.size(), 0); // No trades should be executed
 
@@ -242,15 +345,824 @@ TEST_F(MatchingEngineTest, MarketOrderNoLiquidity) {
 }
 
 //--------Edge Case Tests-------- //
+TEST_F(MatchingEngineTest, SellTakersForEveryOrderType) {
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::LIMIT, 152, 10));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150, 10));
+    engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::LIMIT, 148, 10));
+
+    // FOK needs 25 at 150 or better but only 20 is there
+    EXPECT_TRUE(
+        engine.process_new_order(makeOrder(4, "AAPL", OrderSide::SELL, OrderType::FOK, 150, 25))
+            .empty());
+    // IOC takes the 152 level and the rest of its 15 is cancelled rather than resting at 151
+    auto trades =
+        engine.process_new_order(makeOrder(5, "AAPL", OrderSide::SELL, OrderType::IOC, 151, 15));
+    ASSERT_EQ(trades.size(), 1);
+    EXPECT_EQ(trades[0].buy_order_id, 1);
+    EXPECT_EQ(trades[0].price, 152);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk(), nullptr);
+    // Market ignores price and sweeps down through 148
+    trades =
+        engine.process_new_order(makeOrder(6, "AAPL", OrderSide::SELL, OrderType::MARKET, 0, 15));
+    ASSERT_EQ(trades.size(), 2);
+    EXPECT_EQ(trades[1].buy_order_id, 3);
+    EXPECT_EQ(trades[1].price, 148);
+    EXPECT_EQ(trades[1].quantity, 5);
+    // Limit sells rest what the bids cannot absorb
+    trades =
+        engine.process_new_order(makeOrder(7, "AAPL", OrderSide::SELL, OrderType::LIMIT, 140, 8));
+    ASSERT_EQ(trades.size(), 1);
+    EXPECT_EQ(trades[0].quantity, 5);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->id, 7);
+}
+
+TEST_F(MatchingEngineTest, ModifyOrderPriorityAndCrossing) {
+    SymbolId aapl = engine.symbols().intern("AAPL");
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 100, 10));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 100, 10));
+    engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::LIMIT, 98, 10));
+    std::vector<Trade> trades;
+    auto sink = [&](const Trade &trade) { trades.push_back(trade); };
+
+    // Size-down in place keeps order 1 ahead of order 2
+    auto replaced = engine.modify_order(1, aapl, 100, 4, sink);
+    ASSERT_TRUE(replaced);
+    EXPECT_EQ(replaced->quantity, 4);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->id, 1);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getL2Quote(1).asks[0].second, 14);
+
+    // Size-up goes to the back of the level
+    ASSERT_TRUE(engine.modify_order(1, aapl, 100, 6, sink));
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->id, 2);
+
+    // Repricing through the bid trades at the bid's price and rests the remainder
+    replaced = engine.modify_order(2, aapl, 98, 15, sink);
+    ASSERT_TRUE(replaced);
+    ASSERT_EQ(trades.size(), 1);
+    EXPECT_EQ(trades[0].buy_order_id, 3);
+    EXPECT_EQ(trades[0].price, 98);
+    EXPECT_EQ(replaced->quantity_filled, 10);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestBid(), nullptr);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->id, 2);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->remaining_qty(), 5);
+
+    // Shrinking to the filled quantity cancels; unknown orders are not found
+    replaced = engine.modify_order(2, aapl, 98, 10, sink);
+    ASSERT_TRUE(replaced);
+    EXPECT_EQ(replaced->status, OrderStatus::CANCELLED);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getOrderbyId(2), nullptr);
+    EXPECT_FALSE(engine.modify_order(2, aapl, 98, 10, sink));
+    EXPECT_EQ(engine.get_order_book("AAPL")->getTotalOrders(), 1);
+}
+
+TEST_F(MatchingEngineTest, MassCancelByUserAndSymbol) {
+    auto place = [&](OrderID id, const char *symbol, UserID user, Price price,
+                     uint32_t session = 0) {
+        Order order   = makeOrder(id, symbol, OrderSide::BUY, OrderType::LIMIT, price, 10);
+        order.user_id = user;
+        order.session = session;
+        engine.process_new_order(order);
+    };
+    place(1, "AAPL", 7, 100);
+    place(2, "MSFT", 7, 200);
+    place(3, "AAPL", 8, 101);
+    place(4, "AAPL", 7, 99);
+    place(5, "MSFT", 8, 201);
+    place(7, "MSFT", 7, 198, 3); // Same user, sent on another session
+    // A fully filled order must leave its user's list
+    Order sell   = makeOrder(6, "AAPL", OrderSide::SELL, OrderType::LIMIT, 101, 10);
+    sell.user_id = 9;
+    EXPECT_EQ(engine.process_new_order(sell).size(), 1);
+
+    auto ids = [](const std::vector<Order> &orders) {
+        std::set<OrderID> out;
+        for (const Order &order : orders) {
+            out.insert(order.id);
+        }
+        return out;
+    };
+    SymbolId aapl = engine.symbols().find("AAPL");
+    SymbolId msft = engine.symbols().find("MSFT");
+    EXPECT_EQ(ids(engine.mass_cancel(7, aapl)), (std::set<OrderID>{1, 4}));
+    EXPECT_EQ(engine.get_order_book(aapl)->getTotalOrders(), 0);
+    EXPECT_TRUE(engine.mass_cancel(8, aapl).empty()); // Order 3 traded away
+    EXPECT_EQ(ids(engine.mass_cancel(7, kInvalidSymbol, 3)), (std::set<OrderID>{7}));
+    EXPECT_EQ(ids(engine.mass_cancel(7)), (std::set<OrderID>{2}));
+    EXPECT_TRUE(engine.mass_cancel(7).empty());
+    BookTop top;
+    ASSERT_TRUE(engine.read_snapshot(msft, top)); // Published after the cancels
+    ASSERT_EQ(top.num_bids, 1);
+    EXPECT_EQ(top.bids[0].price, 201);
+    EXPECT_EQ(ids(engine.cancel_all(msft)), (std::set<OrderID>{5}));
+    EXPECT_EQ(engine.get_order_book(msft)->getTotalOrders(), 0);
+    EXPECT_TRUE(engine.mass_cancel(8).empty()); // Cancelled above, so unlinked too
+}
+
 TEST_F(MatchingEngineTest, selfMatching) {
     // Buy 100 @ 150
-    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150.0, 100));
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150, 100));
 
     // Sell 100 @ 150 from the same user (should not match with itself)
     auto trades = engine.process_new_order(
-        makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150.0, 100));
+        makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100));
 
     EXPECT_EQ(trades.size(), 1);           // One trade should be executed
     EXPECT_EQ(trades[0].buy_order_id, 1);  // Buy order ID should be 1
     EXPECT_EQ(trades[0].sell_order_id, 2); // Sell order ID should be 2
 }
+
+// --------Instrument / Tick Tests-------- //
+TEST_F(MatchingEngineTest, InstrumentTickConversion) {
+    Instrument inst = Instrument::fromTickSize("AAPL", 0.05);
+    EXPECT_EQ(inst.price_scale, 100);
+    EXPECT_EQ(inst.tick_size, 5);
+
+    EXPECT_EQ(inst.to_ticks(150.10), 3002);
+    EXPECT_DOUBLE_EQ(inst.to_price(3002), 150.10);
+    EXPECT_TRUE(inst.is_on_tick(150.10));
+    EXPECT_FALSE(inst.is_on_tick(150.12));
+
+    // Floating point noise must not create a separate level
+    EXPECT_EQ(inst.to_ticks(150.1), inst.to_ticks(150.10000000001));
+}
+
+TEST_F(MatchingEngineTest, InstrumentRegistryDefaults) {
+    engine.instruments().add(Instrument::fromTickSize("ES", 0.25));
+    EXPECT_EQ(engine.instruments().get("ES").to_ticks(4500.25), 18001);
+    // Unknown symbols fall back to the default one-cent grid
+    EXPECT_EQ(engine.instruments().get("AAPL").to_ticks(150.01), 15001);
+}
+
+// --------Price Ladder Tests-------- //
+TEST_F(MatchingEngineTest, PriceLadderOutsideWindow) {
+    OrderBook book("TEST", 16); // Tiny window to force overflow and recentering
+    RestingOrder b1 = makeResting(1, OrderSide::BUY, 100, 10);
+    RestingOrder b2 = makeResting(2, OrderSide::BUY, 105, 20);
+    RestingOrder b3 = makeResting(3, OrderSide::BUY, 1000, 30);
+    RestingOrder s1 = makeResting(4, OrderSide::SELL, 5000, 40);
+    RestingOrder s2 = makeResting(5, OrderSide::SELL, 1200, 50);
+    for (RestingOrder *o : {&b1, &b2, &b3, &s1, &s2}) {
+        book.add_order(o);
+    }
+
+    EXPECT_EQ(book.getBestBid()->id, 3); // Far better bid recentres the window
+    EXPECT_EQ(book.getBestAsk()->id, 5);
+
+    auto l2 = book.getL2Quote(5);
+    ASSERT_EQ(l2.bids.size(), 3);
+    EXPECT_EQ(l2.bids[0].first, 1000);
+    EXPECT_EQ(l2.bids[1].first, 105);
+    EXPECT_EQ(l2.bids[2].first, 100);
+    ASSERT_EQ(l2.asks.size(), 2);
+    EXPECT_EQ(l2.asks[0].first, 1200);
+    EXPECT_EQ(l2.asks[1].first, 5000);
+
+    // Draining the touch falls back to the levels parked outside the window
+    book.cancel_order(3);
+    EXPECT_EQ(book.getBestBid()->id, 2);
+    book.cancel_order(2);
+    EXPECT_EQ(book.getBestBid()->id, 1);
+    EXPECT_EQ(book.getBuyOrders(), 1);
+    EXPECT_EQ(book.getSellOrders(), 2);
+}
+
+TEST_F(MatchingEngineTest, MarketOrderSweepsAcrossWindow) {
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 100));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 100000, 100));
+
+    auto trades =
+        engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::MARKET, 0, 150));
+
+    ASSERT_EQ(trades.size(), 2);
+    EXPECT_EQ(trades[0].price, 150);
+    EXPECT_EQ(trades[1].price, 100000);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->remaining_qty(), 50);
+}
+
+TEST_F(MatchingEngineTest, LevelBitmapMatchesReference) {
+    LevelBitmap bits(300000); // Three summary levels
+    std::set<size_t> ref;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> slot(0, bits.size() - 1);
+
+    for (int round = 0; round < 2000; ++round) {
+        size_t i = slot(rng);
+        if (ref.count(i)) {
+            bits.clear(i);
+            ref.erase(i);
+        } else {
+            bits.set(i);
+            ref.insert(i);
+        }
+
+        size_t probe = slot(rng);
+        auto next    = ref.lower_bound(probe);
+        EXPECT_EQ(bits.find_next(probe), next == ref.end() ? LevelBitmap::npos : *next);
+        auto prev = ref.upper_bound(probe);
+        EXPECT_EQ(bits.find_prev(probe),
+                  prev == ref.begin() ? LevelBitmap::npos : *std::prev(prev));
+    }
+    EXPECT_EQ(bits.find_next(0), *ref.begin());
+    EXPECT_EQ(bits.find_prev(bits.size() - 1), *ref.rbegin());
+}
+
+// --------Level Aggregate Tests-------- //
+TEST_F(MatchingEngineTest, LevelAggregatesTrackFillsAndCancels) {
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 30));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 70));
+    engine.process_new_order(makeOrder(3, "AAPL", OrderSide::SELL, OrderType::LIMIT, 151, 50));
+
+    // Partially consume the first order at 150
+    engine.process_new_order(makeOrder(4, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150, 20));
+
+    OrderBook *book = engine.get_order_book("AAPL");
+    auto l2         = book->getL2Quote(5);
+    ASSERT_EQ(l2.asks.size(), 2);
+    EXPECT_EQ(l2.asks[0], std::make_pair(Price{150}, Quantity{80}));
+    EXPECT_EQ(l2.asks[1], std::make_pair(Price{151}, Quantity{50}));
+    EXPECT_EQ(book->getSellOrders(), 3);
+
+    // Cancelling the partially filled order removes only its open quantity
+    engine.cancel_order(1, engine.symbols().find("AAPL"), 1);
+    l2 = book->getL2Quote(5);
+    EXPECT_EQ(l2.asks[0], std::make_pair(Price{150}, Quantity{70}));
+    EXPECT_EQ(book->getBestAsk()->id, 2);
+    EXPECT_EQ(book->getSellOrders(), 2);
+}
+
+TEST_F(MatchingEngineTest, LevelUpdatesAreCoalescedUntilDrained) {
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 30));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 151, 50));
+    engine.process_new_order(makeOrder(3, "AAPL", OrderSide::BUY, OrderType::LIMIT, 148, 10));
+
+    using Action = LevelUpdate::Action;
+    using Level  = std::tuple<Action, OrderSide, Price, Quantity>;
+    std::vector<Level> levels;
+    auto collect = [&](const LevelUpdate &u) {
+        levels.emplace_back(u.action, u.side, u.price, u.quantity);
+    };
+    OrderBook *book = engine.get_order_book("AAPL");
+    EXPECT_FALSE(book->records_level_updates());
+    book->start_level_updates(collect);
+    EXPECT_TRUE(book->records_level_updates());
+    EXPECT_EQ(levels.size(), 3); // The current book, as Adds
+
+    levels.clear();
+    engine.process_new_order(makeOrder(4, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 20));
+    engine.process_new_order(makeOrder(5, "AAPL", OrderSide::BUY, OrderType::LIMIT, 150, 30));
+    engine.process_new_order(makeOrder(6, "AAPL", OrderSide::SELL, OrderType::LIMIT, 152, 5));
+    engine.cancel_order(6, engine.symbols().find("AAPL"), 1); // Came and went: not reported
+    engine.cancel_order(3, engine.symbols().find("AAPL"), 0);
+    engine.process_new_order(makeOrder(7, "AAPL", OrderSide::BUY, OrderType::LIMIT, 149, 7));
+    book->drain_level_updates(collect);
+    std::vector<Level> expected = {{Action::DELETE, OrderSide::BUY, 148, 0},
+                                   {Action::ADD, OrderSide::BUY, 149, 7},
+                                   {Action::CHANGE, OrderSide::SELL, 150, 20}};
+    EXPECT_EQ(levels, expected);
+
+    levels.clear();
+    book->drain_level_updates(collect);
+    EXPECT_TRUE(levels.empty());
+}
+
+TEST_F(MatchingEngineTest, L2FeedSequencesDeltasAndSnapshots) {
+    SymbolId symbol        = engine.symbols().intern("AAPL");
+    const Instrument &inst = engine.symbols().instrument(symbol);
+
+    // Messages are packed; copy each one out before looking at it
+    struct Message {
+        uint64_t seq;
+        uint8_t flags;
+        std::vector<std::tuple<uint8_t, double, uint64_t, uint8_t>> levels; // side, price, qty, action
+    };
+    auto parse = [](const std::vector<char> &out) {
+        std::vector<Message> messages;
+        size_t at = 0;
+        while (at < out.size()) {
+            MarketDataUpdate msg;
+            std::memcpy(&msg, out.data() + at, std::min(sizeof(msg), out.size() - at));
+            EXPECT_EQ(msg.header.type, MessageType::MARKET_DATA_UPDATE);
+            Message m{msg.seq_num, msg.flags, {}};
+            for (size_t i = 0; i < msg.num_levels; ++i) {
+                m.levels.emplace_back(msg.levels[i].side, msg.levels[i].price,
+                                      msg.levels[i].quantity, msg.levels[i].action);
+            }
+            EXPECT_EQ(msg.header.msg_len,
+                      offsetof(MarketDataUpdate, levels) + msg.num_levels * sizeof(L2Delta));
+            at += msg.header.msg_len;
+            messages.push_back(std::move(m));
+        }
+        return messages;
+    };
+
+    L2Feed::WireSymbol aapl = "AAPL"; // Padded to the wire width
+    L2Feed feed;
+    feed.apply(symbol, {LevelUpdate::Action::ADD, OrderSide::BUY, 100, 10});
+    feed.apply(symbol, {LevelUpdate::Action::ADD, OrderSide::SELL, 101, 5});
+    EXPECT_FALSE(feed.ready(symbol));
+    feed.set_ready(symbol);
+
+    // Only the net change per level goes out; a level that came and went does not
+    feed.apply(symbol, {LevelUpdate::Action::CHANGE, OrderSide::BUY, 100, 12});
+    feed.apply(symbol, {LevelUpdate::Action::CHANGE, OrderSide::BUY, 100, 15});
+    feed.apply(symbol, {LevelUpdate::Action::ADD, OrderSide::BUY, 99, 3});
+    feed.apply(symbol, {LevelUpdate::Action::DELETE, OrderSide::BUY, 99, 0});
+    feed.apply(symbol, {LevelUpdate::Action::DELETE, OrderSide::SELL, 101, 0});
+    std::vector<char> out;
+    EXPECT_EQ(feed.encode_updates(symbol, aapl, inst, out), 1);
+    auto messages = parse(out);
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(messages[0].seq, 1);
+    EXPECT_EQ(messages[0].flags, 0);
+    ASSERT_EQ(messages[0].levels.size(), 2);
+    EXPECT_EQ(messages[0].levels[0], std::make_tuple(uint8_t{0}, 1.00, uint64_t{15}, uint8_t{1}));
+    EXPECT_EQ(messages[0].levels[1], std::make_tuple(uint8_t{1}, 1.01, uint64_t{0}, uint8_t{2}));
+    out.clear();
+    EXPECT_EQ(feed.encode_updates(symbol, aapl, inst, out), 0);
+    EXPECT_TRUE(out.empty());
+
+    // More levels than fit in one message: each message takes the next number
+    for (Price price = 200; price < 300; ++price) {
+        feed.apply(symbol, {LevelUpdate::Action::ADD, OrderSide::SELL, price, 1});
+    }
+    EXPECT_EQ(feed.encode_updates(symbol, aapl, inst, out), 3);
+    messages = parse(out);
+    ASSERT_EQ(messages.size(), 3);
+    EXPECT_EQ(messages[2].seq, 4);
+    EXPECT_EQ(messages[2].levels.size(), 100 - 2 * MarketDataUpdate::kMaxLevels);
+    EXPECT_EQ(feed.sequence(symbol), 4);
+
+    // A snapshot carries the last delta's number and brackets the whole book
+    out.clear();
+    feed.encode_snapshot(symbol, aapl, inst, out);
+    messages = parse(out);
+    ASSERT_EQ(messages.size(), 3);
+    size_t total = 0;
+    for (const Message &m : messages) {
+        EXPECT_EQ(m.seq, 4);
+        total += m.levels.size();
+    }
+    EXPECT_EQ(total, 101);
+    EXPECT_EQ(messages[0].flags, MarketDataUpdate::kSnapshotBegin);
+    EXPECT_EQ(messages[1].flags, 0);
+    EXPECT_EQ(messages[2].flags, MarketDataUpdate::kSnapshotEnd);
+    EXPECT_EQ(messages[0].levels[0], std::make_tuple(uint8_t{0}, 1.00, uint64_t{15}, uint8_t{0}));
+}
+
+// --------Order Index Tests-------- //
+TEST_F(MatchingEngineTest, FlatHashMapMatchesReference) {
+    FlatHashMap<OrderID, uint64_t> map(8); // Start small so growth and wrap-around are exercised
+    std::unordered_map<OrderID, uint64_t> ref;
+    std::mt19937_64 rng(7);
+
+    for (int round = 0; round < 20000; ++round) {
+        OrderID key = rng() % 4096; // Dense key space forces long probe runs and backward shifts
+        if (rng() % 3 == 0) {
+            EXPECT_EQ(map.erase(key), ref.erase(key) == 1);
+        } else {
+            EXPECT_EQ(map.insert_or_assign(key, round), ref.count(key) == 0);
+            ref[key] = round;
+        }
+        OrderID probe = rng() % 4096;
+        auto it       = ref.find(probe);
+        uint64_t *hit = map.find(probe);
+        ASSERT_EQ(hit != nullptr, it != ref.end());
+        if (hit) {
+            EXPECT_EQ(*hit, it->second);
+        }
+    }
+    EXPECT_EQ(map.size(), ref.size());
+    for (const auto &[key, value] : ref) {
+        ASSERT_NE(map.find(key), nullptr);
+        EXPECT_EQ(*map.find(key), value);
+    }
+}
+
+// --------Symbol Table Tests-------- //
+TEST_F(MatchingEngineTest, SymbolInterningIsPaddingInsensitive) {
+    char padded[10] = {'A', 'A', 'P', 'L', ' ', ' ', ' ', ' ', ' ', ' '};
+    char nul[10]    = {'A', 'A', 'P', 'L'};
+
+    SymbolId id = engine.symbols().intern(padded, sizeof(padded));
+    EXPECT_EQ(engine.symbols().intern(nul, sizeof(nul)), id);
+    EXPECT_EQ(engine.symbols().find("AAPL"), id);
+    EXPECT_EQ(engine.symbols().name(id), "AAPL");
+    EXPECT_EQ(std::string(engine.symbols().wire(id), 4), "AAPL");
+    EXPECT_EQ(engine.symbols().wire(id)[4], '\0');
+
+    EXPECT_NE(engine.symbols().intern("MSFT"), id);
+    EXPECT_EQ(engine.symbols().find("GOOG"), kInvalidSymbol);
+    EXPECT_EQ(engine.symbols().intern("   "), kInvalidSymbol);
+
+    // Books are indexed by the interned id
+    OrderBook *book = &engine.get_or_create_order_book(id);
+    EXPECT_EQ(engine.get_order_book("AAPL"), book);
+}
+
+// --------Object Pool Tests-------- //
+TEST_F(MatchingEngineTest, ObjectPoolGrowsBySlabs) {
+    ObjectPool<RestingOrder> pool(4, 10, true, 4); // One slab of 4, at most 10 live objects
+    std::vector<std::pair<RestingOrder *, uint32_t>> live;
+    for (OrderID id = 0; id < 10; ++id) {
+        uint32_t index = 0;
+        RestingOrder *order = pool.allocate(index);
+        ASSERT_NE(order, nullptr);
+        order->id = id;
+        live.emplace_back(order, index);
+    }
+    EXPECT_EQ(pool.capacity(), 12);
+    uint32_t index = 0;
+    EXPECT_EQ(pool.allocate(index), nullptr); // At the limit
+
+    // Growing never moves existing objects
+    for (size_t i = 0; i < live.size(); ++i) {
+        EXPECT_EQ(live[i].first->id, i);
+        EXPECT_EQ(&pool.at(live[i].second), live[i].first);
+    }
+
+    // Freed slots are reused most recent first
+    pool.deallocate(live[3].first, live[3].second);
+    pool.deallocate(live[7].first, live[7].second);
+    EXPECT_EQ(pool.allocate(index), live[7].first);
+    EXPECT_EQ(index, live[7].second);
+    EXPECT_EQ(pool.allocate(index), live[3].first);
+}
+
+TEST_F(MatchingEngineTest, OrdersThatCannotBeTakenAreReportedAsSuch) {
+    Config &config          = Config::getInstance();
+    size_t saved_limit      = config.order_pool_limit;
+    config.order_pool_limit = 2;
+    MatchingEngine limited;
+    config.order_pool_limit = saved_limit;
+    SymbolId aapl           = limited.symbols().intern("AAPL");
+    auto outcome = [&](OrderID id, OrderSide side, OrderType type, Price price, Quantity qty) {
+        Order order{.id = id, .symbol = aapl, .side = side, .type = type, .price = price,
+                    .quantity = qty};
+        return limited.process_new_order(order, [](const Trade &) { FAIL() << "traded"; })
+            .outcome;
+    };
+
+    EXPECT_EQ(outcome(1, OrderSide::SELL, OrderType::LIMIT, 150, 10), OrderOutcome::ACCEPTED);
+    EXPECT_EQ(outcome(2, OrderSide::SELL, OrderType::LIMIT, 151, 10), OrderOutcome::ACCEPTED);
+    // The pool is at its limit: the order is refused, not silently dropped
+    EXPECT_EQ(outcome(3, OrderSide::SELL, OrderType::LIMIT, 152, 10), OrderOutcome::REJECTED);
+    EXPECT_EQ(outcome(4, OrderSide::BUY, OrderType::FOK, 151, 30), OrderOutcome::KILLED);
+    EXPECT_EQ(outcome(5, OrderSide::BUY, OrderType::LIMIT, 150, 0), OrderOutcome::REJECTED);
+
+    limited.begin_auction(aapl);
+    EXPECT_EQ(outcome(6, OrderSide::BUY, OrderType::MARKET, 0, 5), OrderOutcome::REJECTED);
+    EXPECT_EQ(limited.get_order_book(aapl)->getTotalOrders(), 2);
+}
+
+TEST_F(MatchingEngineTest, TradeSinkReceivesFillsInOrder) {
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 30));
+    engine.process_new_order(makeOrder(2, "AAPL", OrderSide::SELL, OrderType::LIMIT, 151, 30));
+
+    Trade fills[4];
+    size_t n     = 0;
+    OrderResult result = engine.process_new_order(
+        makeOrder(3, "AAPL", OrderSide::BUY, OrderType::LIMIT, 151, 50),
+        [&](const Trade &trade) { fills[n++] = trade; });
+
+    EXPECT_EQ(result.outcome, OrderOutcome::ACCEPTED);
+    ASSERT_EQ(result.trades, 2);
+    ASSERT_EQ(n, 2);
+    EXPECT_EQ(fills[0].sell_order_id, 1);
+    EXPECT_EQ(fills[0].quantity, 30);
+    EXPECT_EQ(fills[1].sell_order_id, 2);
+    EXPECT_EQ(fills[1].quantity, 20);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->remaining_qty(), 10);
+}
+
+TEST_F(MatchingEngineTest, ProcessOrdersMatchesOneAtATime) {
+    // Interleaved symbols, an invalid order and a partial fill that rests
+    std::vector<Order> batch = {
+        makeOrder(1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 150, 30),
+        makeOrder(2, "MSFT", OrderSide::BUY, OrderType::LIMIT, 300, 10),
+        makeOrder(3, "AAPL", OrderSide::SELL, OrderType::LIMIT, 151, 30),
+        makeOrder(4, "MSFT", OrderSide::SELL, OrderType::LIMIT, 299, 25),
+        makeOrder(5, "AAPL", OrderSide::BUY, OrderType::LIMIT, 151, 0), // Invalid quantity
+        makeOrder(6, "AAPL", OrderSide::BUY, OrderType::LIMIT, 151, 50),
+        makeOrder(7, "MSFT", OrderSide::BUY, OrderType::MARKET, 0, 5),
+    };
+
+    MatchingEngine sequential;
+    std::vector<Trade> expected;
+    for (Order order : batch) {
+        order.symbol = sequential.symbols().intern(engine.symbols().name(order.symbol));
+        sequential.process_new_order(order, [&](const Trade &trade) { expected.push_back(trade); });
+    }
+
+    std::vector<Trade> batched;
+    size_t count =
+        engine.process_orders(batch, [&](const Trade &trade) { batched.push_back(trade); });
+    ASSERT_EQ(count, expected.size());
+
+    // Same fills per symbol in the same order; symbols may interleave differently
+    auto by_symbol = [](const std::vector<Trade> &trades) {
+        std::map<SymbolId, std::vector<std::tuple<OrderID, OrderID, Price, Quantity>>> out;
+        for (const Trade &t : trades) {
+            out[t.symbol].emplace_back(t.buy_order_id, t.sell_order_id, t.price, t.quantity);
+        }
+        return out;
+    };
+    EXPECT_EQ(by_symbol(batched), by_symbol(expected));
+    EXPECT_EQ(engine.get_order_book("AAPL")->getBestAsk()->remaining_qty(), 10);
+    EXPECT_EQ(engine.get_order_book("MSFT")->getBestAsk()->remaining_qty(), 10);
+    EXPECT_EQ(engine.get_order_book("AAPL")->getTotalOrders(),
+              sequential.get_order_book("AAPL")->getTotalOrders());
+}
+
+// --------Trade History Tests-------- //
+TEST_F(MatchingEngineTest, TradeHistorySpillsOldTradesToDisk) {
+    auto path = std::filesystem::temp_directory_path() / "ome_test_trade_spill.bin";
+    {
+        TradeHistory history(8, path.string());
+        for (uint64_t i = 0; i < 100; ++i) {
+            Trade trade{};
+            trade.buy_order_id = i;
+            trade.price        = static_cast<Price>(1000 + i);
+            trade.quantity     = 1;
+            trade.timestamp    = 10 * i;
+            EXPECT_EQ(history.append(trade), i);
+        }
+        EXPECT_EQ(history.size(), 100);
+        EXPECT_EQ(history.first_available(), 0);
+
+        // Range straddling the file and the ring
+        auto trades = history.range_by_sequence(85, 95);
+        ASSERT_EQ(trades.size(), 10);
+        for (uint64_t i = 0; i < trades.size(); ++i) {
+            EXPECT_EQ(trades[i].sequence, 85 + i);
+            EXPECT_EQ(trades[i].buy_order_id, 85 + i);
+            EXPECT_EQ(trades[i].price, static_cast<Price>(1085 + i));
+        }
+
+        auto by_time = history.range_by_time(205, 260); // Timestamps 210..250
+        ASSERT_EQ(by_time.size(), 5);
+        EXPECT_EQ(by_time.front().sequence, 21);
+        EXPECT_EQ(by_time.back().sequence, 25);
+    }
+    // The file holds exactly the evicted trades
+    EXPECT_EQ(std::filesystem::file_size(path), 92 * sizeof(TradeHistory::Record));
+    std::filesystem::remove(path);
+
+    // Without a spill file only the ring is queryable
+    TradeHistory memory_only(8);
+    for (uint64_t i = 0; i < 20; ++i) {
+        Trade trade{};
+        trade.timestamp = i;
+        memory_only.append(trade);
+    }
+    EXPECT_EQ(memory_only.first_available(), 12);
+    EXPECT_EQ(memory_only.range_by_sequence(0, 20).size(), 8);
+
+    // A clock stepping back leaves the history unsorted by time; nothing is missed
+    TradeHistory stepped(8);
+    for (Timestamp ts : {100, 110, 120, 50, 60, 130}) {
+        Trade trade{};
+        trade.timestamp = ts;
+        stepped.append(trade);
+    }
+    auto by_time = stepped.range_by_time(55, 115); // 100, 110, 60 in sequence order
+    ASSERT_EQ(by_time.size(), 3);
+    EXPECT_EQ(by_time[0].sequence, 0);
+    EXPECT_EQ(by_time[1].sequence, 1);
+    EXPECT_EQ(by_time[2].sequence, 4);
+}
+
+// --------Sharded Engine Tests-------- //
+TEST_F(MatchingEngineTest, ShardedEngineMatchesPerSymbolInOrder) {
+    ShardedEngine shards(2, 64);
+    SymbolId aapl = engine.symbols().intern("AAPL");
+    SymbolId msft = engine.symbols().intern("MSFT");
+    ASSERT_NE(shards.shard_of(aapl), shards.shard_of(msft));
+
+    auto submit = [&](Order order) {
+        ShardedEngine::Command command{.kind       = ShardedEngine::Command::Kind::NEW_ORDER,
+                                       .generation = 7,
+                                       .order      = order};
+        std::memcpy(command.symbol, engine.symbols().wire(order.symbol), sizeof(command.symbol));
+        ASSERT_TRUE(shards.try_submit(command));
+    };
+    // Two resting sells per symbol, then a buy that sweeps both
+    for (const char *symbol : {"AAPL", "MSFT"}) {
+        OrderID base = symbol[0] == 'A' ? 10 : 20;
+        submit(makeOrder(base + 1, symbol, OrderSide::SELL, OrderType::LIMIT, 101, 10));
+        submit(makeOrder(base + 2, symbol, OrderSide::SELL, OrderType::LIMIT, 100, 10));
+        submit(makeOrder(base + 3, symbol, OrderSide::BUY, OrderType::LIMIT, 101, 15));
+    }
+
+    std::map<SymbolId, std::vector<Trade>> trades;
+    size_t done = 0;
+    while (shards.pending() > 0) {
+        shards.poll([&](size_t, const ShardedEngine::Event &event) {
+            EXPECT_EQ(event.generation, 7); // Results carry their command's connection
+            if (event.kind == ShardedEngine::Event::Kind::TRADE) {
+                trades[event.trade.symbol].push_back(event.trade);
+            } else {
+                ++done;
+            }
+        });
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(done, 6);
+    for (SymbolId symbol : {aapl, msft}) {
+        OrderID base = symbol == aapl ? 10 : 20;
+        ASSERT_EQ(trades[symbol].size(), 2);
+        EXPECT_EQ(trades[symbol][0].sell_order_id, base + 2); // Best price first
+        EXPECT_EQ(trades[symbol][0].quantity, 10);
+        EXPECT_EQ(trades[symbol][1].sell_order_id, base + 1);
+        EXPECT_EQ(trades[symbol][1].quantity, 5);
+    }
+}
+
+TEST_F(MatchingEngineTest, MpscQueueKeepsPerProducerOrder) {
+    constexpr uint64_t kProducers = 4;
+    constexpr uint64_t kPerProducer = 5000;
+    MpscQueue<uint64_t> queue(64);
+
+    std::vector<std::thread> producers;
+    for (uint64_t p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&queue, p] {
+            for (uint64_t i = 0; i < kPerProducer; ++i) {
+                while (!queue.try_push(p << 32 | i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<uint64_t> next(kProducers, 0);
+    uint64_t received = 0;
+    uint64_t value    = 0;
+    while (received < kProducers * kPerProducer) {
+        if (!queue.try_pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t producer = value >> 32;
+        ASSERT_LT(producer, kProducers);
+        EXPECT_EQ(value & 0xffffffff, next[producer]++);
+        ++received;
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+}
+
+TEST_F(MatchingEngineTest, PublishedSnapshotsAreConsistentAcrossThreads) {
+    SymbolId aapl = engine.symbols().intern("AAPL");
+    BookTop top;
+    EXPECT_FALSE(engine.read_snapshot(aapl, top));
+
+    // Each batch adds a bid and an ask of the same size and publishes once, so a reader
+    // that sees both must see equal quantities; anything else is a torn read
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        BookTop seen;
+        while (!done.load(std::memory_order_acquire)) {
+            if (engine.read_snapshot(aapl, seen) && seen.num_bids == 1 && seen.num_asks == 1) {
+                EXPECT_EQ(seen.bids[0].quantity, seen.asks[0].quantity);
+            }
+        }
+    });
+    for (Quantity q = 1; q <= 2000; ++q) {
+        Order batch[] = {makeOrder(2 * q, "AAPL", OrderSide::BUY, OrderType::LIMIT, 100, q),
+                         makeOrder(2 * q + 1, "AAPL", OrderSide::SELL, OrderType::LIMIT, 200, q)};
+        engine.process_orders(batch, [](const Trade &) {});
+        engine.cancel_order(2 * q, aapl, 0);
+        engine.cancel_order(2 * q + 1, aapl, 1);
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    engine.process_new_order(makeOrder(1, "AAPL", OrderSide::BUY, OrderType::LIMIT, 99, 7));
+    ASSERT_TRUE(engine.read_snapshot(aapl, top));
+    EXPECT_EQ(top.num_bids, 1);
+    EXPECT_EQ(top.num_asks, 0);
+    EXPECT_EQ(top.bids[0].price, 99);
+    EXPECT_EQ(top.bids[0].quantity, 7);
+}
+
+TEST_F(MatchingEngineTest, RecvBufferKeepsPartialFramesAcrossReads) {
+    RecvBuffer buffer;
+    char frame[211];
+    for (size_t i = 0; i < sizeof(frame); ++i) {
+        frame[i] = static_cast<char>(i);
+    }
+
+    // Reads never line up with frame ends before the buffer fills, so it has to compact
+    // a partial frame to the front
+    size_t sent = 0, decoded = 0;
+    while (decoded < 500) {
+        auto [ptr, space] = buffer.reserve();
+        ASSERT_GE(space, RecvBuffer::kMaxFrame);
+        size_t len = std::min<size_t>(199, space);
+        for (size_t i = 0; i < len; ++i) {
+            ptr[i] = frame[(sent + i) % sizeof(frame)];
+        }
+        EXPECT_EQ(ptr, buffer.write_ptr());
+        buffer.commit(len);
+        sent += len;
+        while (buffer.readable() >= sizeof(frame)) {
+            ASSERT_EQ(std::memcmp(buffer.read_ptr(), frame, sizeof(frame)), 0);
+            buffer.consume(sizeof(frame));
+            ++decoded;
+        }
+    }
+    EXPECT_EQ(buffer.readable(), sent - decoded * sizeof(frame));
+
+    // Bytes received elsewhere are copied in
+    buffer.clear();
+    EXPECT_EQ(buffer.append(frame, sizeof(frame)), sizeof(frame));
+    EXPECT_EQ(buffer.readable(), sizeof(frame));
+    EXPECT_EQ(std::memcmp(buffer.read_ptr(), frame, sizeof(frame)), 0);
+}
+
+TEST_F(MatchingEngineTest, OutboundBuffersSurviveAFullSocket) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    int size = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    // Far more than the socket holds: the flush stops short and keeps the rest queued
+    OutboundBuffers out;
+    std::vector<char> expected;
+    for (uint32_t i = 0; i < 20000; ++i) {
+        char packet[sizeof(i)];
+        std::memcpy(packet, &i, sizeof(i));
+        EXPECT_EQ(out.append(fds[0], packet, sizeof(packet)), (i + 1) * sizeof(i));
+        expected.insert(expected.end(), packet, packet + sizeof(packet));
+    }
+    out.flush();
+
+    std::vector<char> received;
+    char chunk[8192];
+    while (received.size() < expected.size()) {
+        ssize_t n = recv(fds[1], chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            received.insert(received.end(), chunk, chunk + n);
+            continue;
+        }
+        ASSERT_TRUE(n < 0 && errno == EAGAIN) << "peer closed early";
+        out.flush(); // Blocked: nothing is written until writable()
+        ASSERT_EQ(recv(fds[1], chunk, sizeof(chunk), 0), -1);
+        out.writable(fds[0]);
+        out.flush();
+    }
+    EXPECT_EQ(received, expected);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+
+TEST_F(MatchingEngineTest, TradingPhaseRequestsNeedTheAdminFlag) {
+    ASSERT_FALSE(Config::getInstance().allow_trading_phase);
+    OrderBook &book = engine.get_or_create_order_book("AAPL");
+
+    constexpr int kPort = 18931;
+    TcpServer server(kPort);
+    ClientGateway gateway(engine, server);
+    std::thread loop([&server]() { server.start(); });
+
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bool connected = connect(client, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    EXPECT_TRUE(connected);
+
+    LoginRequest login{};
+    login.header = {0, MessageType::LOGIN_REQUEST, sizeof(LoginRequest)};
+    TradingPhaseRequest phase{};
+    phase.header = {0, MessageType::TRADING_PHASE, sizeof(TradingPhaseRequest)};
+    std::memcpy(phase.symbol, "AAPL", 4);
+    phase.phase = 1;
+    // The second login is answered only once the phase request has been handled
+    std::vector<char> request;
+    for (auto [data, len] : {std::pair{reinterpret_cast<const char *>(&login), sizeof(login)},
+                             {reinterpret_cast<const char *>(&phase), sizeof(phase)},
+                             {reinterpret_cast<const char *>(&login), sizeof(login)}}) {
+        request.insert(request.end(), data, data + len);
+    }
+    size_t received = 0;
+    if (connected && send(client, request.data(), request.size(), 0) == ssize_t(request.size())) {
+        char reply[2 * sizeof(LoginResponse)];
+        while (received < sizeof(reply)) {
+            ssize_t n = recv(client, reply + received, sizeof(reply) - received, 0);
+            if (n <= 0) {
+                break;
+            }
+            received += n;
+        }
+    }
+    server.stop();
+    loop.join();
+    close(client);
+
+    EXPECT_EQ(received, 2 * sizeof(LoginResponse));
+    EXPECT_EQ(book.phase(), OrderBook::Phase::CONTINUOUS);
+}